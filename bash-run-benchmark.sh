@@ -0,0 +1,44 @@
+#!/bin/bash
+
+if [ "$#" -lt 4 ]; then
+    echo "Usage: $0 <q_min> <q_max> <p_min> <p_max> [runs] [warmup] [sort options...]"
+    exit 1
+fi
+
+Q_MIN=$1
+Q_MAX=$2
+P_MIN=$3
+P_MAX=$4
+RUNS=${5:-10}
+WARMUP=${6:-2}
+shift $(( $# < 6 ? $# : 6 ))
+
+for VALUE in "$Q_MIN" "$Q_MAX" "$P_MIN" "$P_MAX" "$RUNS" "$WARMUP"; do
+    if ! [[ "$VALUE" =~ ^[0-9]+$ ]]; then
+        echo "Error: q, p, runs and warmup must be non-negative integers."
+        exit 1
+    fi
+done
+
+# Launcher and output can be overridden, e.g. MPIRUN="mpirun --oversubscribe"
+MPIRUN=${MPIRUN:-mpirun}
+CSV=${BENCH_CSV:-logs/benchmark.csv}
+mkdir -p "$(dirname "$CSV")"
+
+# Build the benchmark (`make benchmark` passes the executable of the selected KEY/PAYLOAD)
+SORT_BENCH=${SORT_BENCH:-./bin/sort_bench}
+make bench
+
+if [ $? -ne 0 ]; then
+    echo "Error: Build failed."
+    exit 1
+fi
+
+# Sweep every (p, q): warm-up runs, timed runs, one CSV row each
+for ((P = P_MIN; P <= P_MAX; P++)); do
+    for ((Q = Q_MIN; Q <= Q_MAX; Q++)); do
+        $MPIRUN -np $((2**P)) "$SORT_BENCH" "$Q" "$P" --runs "$RUNS" --warmup "$WARMUP" --csv "$CSV" "$@"
+    done
+done
+
+echo "Results appended to $CSV"
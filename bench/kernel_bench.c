@@ -0,0 +1,261 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include "../inc/config.h"
+#include "../inc/utils.h"
+#include "../inc/generator.h"
+#include "../inc/row_sort_operations.h"
+#include "../inc/pairwise_kernels.h"
+
+#define MIN_LOG_COLS     10     // Smallest row: 2^10 elements, L1 resident
+#define MAX_LOG_COLS     27     // Largest row
+#define TARGET_ELEMENTS  (1 << 26)  // Elements processed per measurement (sets the repetitions)
+#define MIN_REPS         3
+
+
+// Kernels under test
+typedef enum {
+    KERNEL_PAIRWISE_SORT,   // Every ISA variant plus the branchy loop of the original code
+    KERNEL_PAIRWISE_KEEP,   // Dispatched variant
+    KERNEL_FIND_ELBOW,      // On a bitonic row
+    KERNEL_ELBOW_SORT,      // On a bitonic row
+    KERNEL_LOCAL_SORT,      // `SORT_VERSION` backend with `--threads`
+    NUM_KERNELS
+} kernel_id_t;
+
+static const char* kernel_names[NUM_KERNELS] = { "pairwise_sort", "pairwise_keep", "find_elbow_element", "elbow_sort", "local_sort" };
+
+// Bytes every kernel has to move at least, in elements per element of the row: GB/s is derived from it
+static const double kernel_traffic[NUM_KERNELS] = { 4.0, 3.0, 1.0, 2.0, 2.0 };
+
+
+// Rows of one measurement: the sources are copied to the work rows before every repetition
+typedef struct {
+    const elem_t* src1;
+    const elem_t* src2;
+    elem_t*       row1;
+    elem_t*       row2;
+    int           cols;
+    bool          ascending;
+    int           restore;      // Number of work rows to restore (0 for read-only kernels)
+} bench_rows_t;
+
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+// The pairwise loop as it was before the SIMD kernels, kept as the reference
+static void pairwise_sort_legacy(elem_t* row1, elem_t* row2, int cols, bool ascending) {
+    for (int j = 0; j < cols; j++) {
+        if ( (ascending && KEY(row1[j]) > KEY(row2[j])) || (!ascending && KEY(row1[j]) < KEY(row2[j])) ) {
+            elem_t temp = row1[j];
+            row1[j] = row2[j];
+            row2[j] = temp;
+        }
+    }
+}
+
+
+// Turns a row into the input of the elbow kernels: an ascending then a descending half, rotated
+// by a quarter so the elbow is inside the row (as after a compare-exchange)
+static void make_bitonic(elem_t* row, elem_t* tmp, int cols, bool ascending) {
+    int half = cols / 2, shift = cols / 4;
+    local_sort(row, half, ascending);
+    local_sort(row + half, cols - half, !ascending);
+    memcpy(tmp, row + shift, (size_t)(cols - shift) * sizeof(elem_t));
+    memcpy(tmp + cols - shift, row, (size_t)shift * sizeof(elem_t));
+    memcpy(row, tmp, (size_t)cols * sizeof(elem_t));
+}
+
+
+// Runs one repetition of a kernel (`variant` selects the pairwise_sort implementation)
+static void run_kernel(kernel_id_t kernel, const char* variant, pairwise_kernel_t pairwise, const bench_rows_t* rows) {
+    switch (kernel) {
+        case KERNEL_PAIRWISE_SORT:
+            if (pairwise) {
+                pairwise(rows->row1, rows->row2, rows->cols);
+            } else if (strcmp(variant, "legacy") == 0) {
+                pairwise_sort_legacy(rows->row1, rows->row2, rows->cols, rows->ascending);
+            }
+            break;
+        case KERNEL_PAIRWISE_KEEP:
+            pairwise_keep(rows->row1, rows->row2, rows->cols, rows->ascending);
+            break;
+        case KERNEL_FIND_ELBOW: {
+            // Keep the result alive so the search is not optimized away
+            volatile int elbow = find_elbow_element(rows->row1, rows->cols, rows->ascending);
+            (void)elbow;
+            break;
+        }
+        case KERNEL_ELBOW_SORT:
+            elbow_sort(rows->row1, rows->cols, rows->ascending);
+            break;
+        default:
+            local_sort(rows->row1, rows->cols, rows->ascending);
+            break;
+    }
+}
+
+
+// Times one kernel: the work rows are restored before each repetition (restore not timed), so
+// every repetition sees the same input and the legacy branch keeps mispredicting
+static double time_kernel(kernel_id_t kernel, const char* variant, const bench_rows_t* rows) {
+    pairwise_kernel_t pairwise = NULL;
+    if (kernel == KERNEL_PAIRWISE_SORT && strcmp(variant, "legacy") != 0) pairwise = pairwise_kernel_get(variant, rows->ascending);
+
+    int reps = TARGET_ELEMENTS / rows->cols;
+    if (reps < MIN_REPS) reps = MIN_REPS;
+
+    double total = 0.0;
+    for (int r = 0; r < reps; r++) {
+        if (rows->restore > 0) memcpy(rows->row1, rows->src1, (size_t)rows->cols * sizeof(elem_t));
+        if (rows->restore > 1) memcpy(rows->row2, rows->src2, (size_t)rows->cols * sizeof(elem_t));
+
+        double start = now_sec();
+        run_kernel(kernel, variant, pairwise, rows);
+        total += now_sec() - start;
+    }
+    return total / reps;
+}
+
+
+static void print_result(kernel_id_t kernel, const char* variant, input_dist_t dist, bool ascending, int cols, double sec) {
+    printf("%s,%s,%s,%s,%d,%.3f,%.1f,%.2f\n", kernel_names[kernel], variant, input_dist_names[dist], ascending ? "asc" : "desc",
+           cols, sec * 1e9 / cols, cols / sec * 1e-6, kernel_traffic[kernel] * sizeof(elem_t) * cols / sec * 1e-9);
+    fflush(stdout);
+}
+
+
+// Index of `name` in `names`, -1 if unknown
+static int lookup(const char* name, const char* const* names, int count) {
+    for (int i = 0; i < count; i++) {
+        if (strcmp(name, names[i]) == 0) return i;
+    }
+    return -1;
+}
+
+
+static void print_usage(const char* program) {
+    printf("Usage: %s [--min <log2 cols>] [--max <log2 cols>] [--step <n>] [--kernel <name>] [--dist <name>] [--threads <n>]\n", program);
+    printf("  Rows of 2^min to 2^max elements (default 2^%d to 2^%d, step 1), every kernel and distribution by default\n", MIN_LOG_COLS, MAX_LOG_COLS);
+    printf("  Kernels: pairwise_sort, pairwise_keep, find_elbow_element, elbow_sort, local_sort\n");
+    printf("  Distributions: uniform, sorted, reversed, nearly-sorted, zipf, equal, organ-pipe\n");
+}
+
+
+int main(int argc, char* argv[]) {
+    int min_log = MIN_LOG_COLS, max_log = MAX_LOG_COLS, step = 1;
+    int only_kernel = -1, only_dist = -1;
+    for (int i = 1; i < argc; i++) {
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        bool valid = (value != NULL);
+        if (valid && strcmp(argv[i], "--min") == 0) {
+            min_log = atoi(value);
+        } else if (valid && strcmp(argv[i], "--max") == 0) {
+            max_log = atoi(value);
+        } else if (valid && strcmp(argv[i], "--step") == 0) {
+            step = atoi(value);
+        } else if (valid && strcmp(argv[i], "--kernel") == 0) {
+            valid = (only_kernel = lookup(value, kernel_names, NUM_KERNELS)) >= 0;
+        } else if (valid && strcmp(argv[i], "--dist") == 0) {
+            valid = (only_dist = lookup(value, input_dist_names, INPUT_NUM_DISTS)) >= 0;
+        } else if (valid && strcmp(argv[i], "--threads") == 0) {
+            sort_config.num_threads = atoi(value);
+        } else {
+            valid = false;
+        }
+        if (!valid) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        i++;
+    }
+    if (min_log < 1 || max_log > 30 || min_log > max_log || step < 1 || sort_config.num_threads < 1) {
+        print_usage(argv[0]);
+        return 1;
+    }
+
+    const char* variants[] = { "legacy", "scalar", "sse4.1", "avx2", "avx512" };
+    const int num_variants = (int)(sizeof(variants) / sizeof(variants[0]));
+
+    int max_cols = 1 << max_log;
+    elem_t* src1 = malloc((size_t)max_cols * sizeof(elem_t));
+    elem_t* src2 = malloc((size_t)max_cols * sizeof(elem_t));
+    elem_t* row1 = malloc((size_t)max_cols * sizeof(elem_t));
+    elem_t* row2 = malloc((size_t)max_cols * sizeof(elem_t));
+    if (!src1 || !src2 || !row1 || !row2) {
+        fprintf(stderr, "kernel_bench: Memory allocation failed (4 rows of 2^%d %s elements, try a smaller --max)\n", max_log, ELEM_NAME);
+        return 1;
+    }
+
+    fprintf(stderr, "Dispatched pairwise kernel: %s (%s elements, %d threads for local_sort)\n",
+            pairwise_kernel_isa(), ELEM_NAME, sort_config.num_threads);
+    printf("kernel,variant,distribution,direction,cols,ns_per_element,melements_per_sec,gb_per_sec\n");
+    for (int d = 0; d < INPUT_NUM_DISTS; d++) {
+        input_dist_t dist = (input_dist_t)d;
+        if (only_dist >= 0 && d != only_dist) continue;
+
+        // The two rows are the halves of one input, the ids give the position inside the pair
+        for (int log_cols = min_log; log_cols <= max_log; log_cols += step) {
+            int cols = 1 << log_cols;
+            generate_input(src1, cols, 0, 2LL * cols, dist, sort_config.seed, sort_config.num_threads);
+            generate_input(src2, cols, cols, 2LL * cols, dist, sort_config.seed, sort_config.num_threads);
+
+            for (int dir = 0; dir < 2; dir++) {
+                bool ascending = (dir == 0);
+                bench_rows_t rows = { src1, src2, row1, row2, cols, ascending, 2 };
+
+                if (only_kernel < 0 || only_kernel == KERNEL_PAIRWISE_SORT) {
+                    for (int v = 0; v < num_variants; v++) {
+                        if (strcmp(variants[v], "legacy") != 0 && !pairwise_kernel_get(variants[v], ascending)) continue;
+                        print_result(KERNEL_PAIRWISE_SORT, variants[v], dist, ascending, cols,
+                                     time_kernel(KERNEL_PAIRWISE_SORT, variants[v], &rows));
+                    }
+                }
+                if (only_kernel < 0 || only_kernel == KERNEL_PAIRWISE_KEEP) {
+                    print_result(KERNEL_PAIRWISE_KEEP, pairwise_kernel_isa(), dist, ascending, cols,
+                                 time_kernel(KERNEL_PAIRWISE_KEEP, pairwise_kernel_isa(), &rows));
+                }
+                if (only_kernel < 0 || only_kernel == KERNEL_LOCAL_SORT) {
+                    rows.restore = 1;
+                    print_result(KERNEL_LOCAL_SORT, "dispatched", dist, ascending, cols,
+                                 time_kernel(KERNEL_LOCAL_SORT, "dispatched", &rows));
+                }
+
+                // The elbow kernels read a bitonic row, built in the second work row
+                if (only_kernel < 0 || only_kernel == KERNEL_FIND_ELBOW || only_kernel == KERNEL_ELBOW_SORT) {
+                    memcpy(row2, src1, (size_t)cols * sizeof(elem_t));
+                    make_bitonic(row2, row1, cols, ascending);
+                    bench_rows_t bitonic = { row2, NULL, row1, NULL, cols, ascending, 1 };
+                    memcpy(row1, row2, (size_t)cols * sizeof(elem_t));
+
+                    if (only_kernel < 0 || only_kernel == KERNEL_FIND_ELBOW) {
+                        bitonic.restore = 0;
+                        print_result(KERNEL_FIND_ELBOW, "dispatched", dist, ascending, cols,
+                                     time_kernel(KERNEL_FIND_ELBOW, "dispatched", &bitonic));
+                    }
+                    if (only_kernel < 0 || only_kernel == KERNEL_ELBOW_SORT) {
+                        bitonic.restore = 1;
+                        print_result(KERNEL_ELBOW_SORT, "dispatched", dist, ascending, cols,
+                                     time_kernel(KERNEL_ELBOW_SORT, "dispatched", &bitonic));
+                    }
+                }
+            }
+        }
+    }
+
+    elbow_sort_release();
+    parallel_sort_release();
+    radix_sort_release();
+    free(src1);
+    free(src2);
+    free(row1);
+    free(row2);
+    return 0;
+}
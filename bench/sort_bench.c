@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <limits.h>
+#include <string.h>
+#include <math.h>
+#include <mpi.h>
+#include "../inc/config.h"
+#include "../inc/arena.h"
+#include "../inc/utils.h"
+#include "../inc/validation.h"
+#include "../inc/topology.h"
+#include "../inc/sort_engine.h"
+#include "../inc/bitonic_plan.h"
+#include "../inc/trace.h"
+#include "../inc/generator.h"
+
+#define DEFAULT_RUNS    10
+#define DEFAULT_WARMUP  2
+#define DEFAULT_CSV     "logs/benchmark.csv"
+#define ISORT_PIECE     (1 << 16)   // Elements of the next input generated between two `bitonic_test`
+
+
+// Options of the benchmark itself, removed from `argv` before the sort options are parsed
+typedef struct {
+    int runs;
+    int warmup;
+    const char* csv;
+    bool plan;      // Sort through one bitonic plan reused by every run (see `bitonic_plan.h`)
+    bool isort;     // Start the plan with `bitonic_isort` and generate the next input meanwhile
+    bool progress;  // Advance the nonblocking sort in a progress thread
+} bench_options_t;
+
+
+static bool parse_bench_options(int* argc, char* argv[], bench_options_t* options) {
+    int kept = 1;
+    for (int i = 1; i < *argc; i++) {
+        const char* value = (i + 1 < *argc) ? argv[i + 1] : NULL;
+        if (strcmp(argv[i], "--runs") == 0 && value) {
+            options->runs = atoi(value);
+            i++;
+        } else if (strcmp(argv[i], "--warmup") == 0 && value) {
+            options->warmup = atoi(value);
+            i++;
+        } else if (strcmp(argv[i], "--csv") == 0 && value) {
+            options->csv = value;
+            i++;
+        } else if (strcmp(argv[i], "--plan") == 0) {
+            options->plan = true;
+        } else if (strcmp(argv[i], "--isort") == 0) {
+            options->plan = options->isort = true;
+        } else if (strcmp(argv[i], "--progress") == 0) {
+            options->plan = options->isort = options->progress = true;
+        } else {
+            argv[kept++] = argv[i];
+        }
+    }
+    *argc = kept;
+    argv[kept] = NULL;
+    return options->runs >= 1 && options->warmup >= 0;
+}
+
+
+static int compare_doubles(const void* a, const void* b) {
+    double x = *(const double*)a, y = *(const double*)b;
+    return (x > y) - (x < y);
+}
+
+
+// Median, 95th percentile (nearest rank), minimum and sample standard deviation
+typedef struct {
+    double median, p95, min, stddev;
+} stats_t;
+
+static stats_t compute_stats(double* values, int n) {
+    stats_t stats;
+    double mean = 0.0, var = 0.0;
+    for (int i = 0; i < n; i++) mean += values[i] / n;
+    for (int i = 0; i < n; i++) var += (values[i] - mean) * (values[i] - mean);
+
+    qsort(values, n, sizeof(double), compare_doubles);
+    stats.median = (n % 2) ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+    stats.p95 = values[(int)ceil(0.95 * n) - 1];
+    stats.min = values[0];
+    stats.stddev = (n > 1) ? sqrt(var / (n - 1)) : 0.0;
+    return stats;
+}
+
+
+static const char* engine_name(sort_engine_t engine) {
+    return (engine == ENGINE_SAMPLE) ? "sample" : (engine == ENGINE_BITONIC) ? "bitonic" : "auto";
+}
+
+
+// Appends one row (and the header to a new file)
+static void write_row(const bench_options_t* options, int size, long long total_elements, const stats_t* time,
+                      const stats_t* rate, const stats_t* bytes, bool valid) {
+    FILE* probe = fopen(options->csv, "r");
+    bool new_file = (probe == NULL);
+    if (probe) {
+        fseek(probe, 0, SEEK_END);
+        new_file = (ftell(probe) == 0);
+        fclose(probe);
+    }
+
+    FILE* file = fopen(options->csv, "a");
+    if (!file) {
+        fprintf(stderr, "Rank 0: Cannot write %s\n", options->csv);
+        return;
+    }
+    if (new_file) {
+        fprintf(file, "elements_type,distribution,engine,exchange,shm,threads,processes,elements,runs,warmup,"
+                      "time_ms_median,time_ms_p95,time_ms_min,time_ms_stddev,"
+                      "melems_per_s_median,melems_per_s_p95,melems_per_s_min,melems_per_s_stddev,"
+                      "mbytes_median,mbytes_p95,mbytes_min,mbytes_stddev,valid\n");
+    }
+    fprintf(file, "%s,%s,%s,%s,%s,%d,%d,%lld,%d,%d,%.4f,%.4f,%.4f,%.4f,%.3f,%.3f,%.3f,%.3f,%.4f,%.4f,%.4f,%.4f,%d\n",
+            ELEM_NAME, input_dist_names[sort_config.input_dist], options->isort ? "isort" : options->plan ? "plan" : engine_name(sort_config.engine), sort_config.exchange_mode == EXCHANGE_SPLIT ? "split" : sort_config.exchange_mode == EXCHANGE_STREAM ? "stream" : "full",
+            sort_config.use_shared_memory ? "on" : "off", sort_config.num_threads, size, total_elements,
+            options->runs, options->warmup,
+            time->median, time->p95, time->min, time->stddev, rate->median, rate->p95, rate->min, rate->stddev,
+            bytes->median, bytes->p95, bytes->min, bytes->stddev, valid ? 1 : 0);
+    fclose(file);
+}
+
+
+int main(int argc, char* argv[]) {
+    int provided;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &provided);
+
+    int rank, size;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    MPI_Comm_size(MPI_COMM_WORLD, &size);
+
+    bench_options_t options = { DEFAULT_RUNS, DEFAULT_WARMUP, DEFAULT_CSV, false, false, false };
+    bool valid_options = parse_bench_options(&argc, argv, &options);
+    bool valid_config = config_init(&argc, argv, rank);
+    if (!valid_options || !valid_config || !(argc == 3 || (argc == 1 && sort_config.total_elements > 0))) {
+        if (rank == 0) {
+            config_print_usage(argv[0]);
+            printf("Benchmark options: --runs <n> (default %d) --warmup <n> (default %d) --csv <file> (default %s) --plan --isort --progress\n",
+                   DEFAULT_RUNS, DEFAULT_WARMUP, DEFAULT_CSV);
+        }
+        MPI_Finalize();
+        return 1;
+    }
+
+    MPI_Comm sort_comm = MPI_COMM_WORLD;
+    if (sort_config.remap_ranks) {
+        sort_comm = topology_comm_create(MPI_COMM_WORLD);
+        MPI_Comm_rank(sort_comm, &rank);
+    }
+
+    long long total_elements = sort_config.total_elements;
+    if (argc == 3) {
+        if ((1 << atoi(argv[2])) != size) {
+            if (rank == 0) printf("Error: 2^p = %d does not match the %d processes (use --elements for any count)\n", 1 << atoi(argv[2]), size);
+            MPI_Finalize();
+            return 1;
+        }
+        if (total_elements == 0) total_elements = (long long)size << atoi(argv[1]);
+    }
+    long long max_cols = (total_elements + size - 1) / size;
+    if (max_cols > INT_MAX) {
+        if (rank == 0) printf("Error: %lld elements per process do not fit in a row\n", max_cols);
+        MPI_Finalize();
+        return 1;
+    }
+    int total_cols = (int)max_cols;
+    int initial_cols = (int)(total_elements / size + (rank < total_elements % size ? 1 : 0));
+    long long first_index = (total_elements / size) * rank + (rank < total_elements % size ? rank : total_elements % size);
+
+    // The rows and the scratch buffers come from the huge-page arena, mapped by the first run and reused by the next ones
+    elem_t* local_row = (elem_t*)arena_reserve(ARENA_ROW, (size_t)total_cols * sizeof(elem_t));
+    elem_t* next_row = options.isort ? (elem_t*)arena_map((size_t)total_cols * sizeof(elem_t)) : NULL;
+    double* times = malloc(options.runs * sizeof(double));
+    double* rates = malloc(options.runs * sizeof(double));
+    double* volumes = malloc(options.runs * sizeof(double));
+    double* faults = malloc(options.runs * sizeof(double));
+    if (!times || !rates || !volumes || !faults || (options.isort && !next_row)) {
+        fprintf(stderr, "Rank %d: Memory allocation failed\n", rank);
+        MPI_Abort(MPI_COMM_WORLD, -1);
+    }
+
+    // A plan sorts same-shaped rows: every process must hold the same number of elements
+    bitonic_plan_t plan;
+    if (options.plan) {
+        if (total_elements % size != 0) {
+            if (rank == 0) printf("Error: --plan needs the same number of elements on every process\n");
+            MPI_Finalize();
+            return 1;
+        }
+        bitonic_plan_create(&plan, local_row, total_cols, sort_comm);
+    }
+
+    // The rank-0 reports of the sort (engine, chunks) are repeated by every run, warm-up included
+    bool valid = true;
+    for (int run = -options.warmup; run < options.runs; run++) {
+        // Same input (`--dist`, `--seed`) for every run of every configuration. With `--isort` it
+        // was generated while the previous run sorted
+        int local_cols = initial_cols;
+        if (options.isort && run > -options.warmup) {
+            memcpy(local_row, next_row, local_cols * sizeof(elem_t));
+        } else {
+            generate_input(local_row, local_cols, first_index, total_elements, sort_config.input_dist, sort_config.seed, sort_config.num_threads);
+        }
+        fingerprint_t input_fingerprint;
+        if (run == options.runs - 1) input_fingerprint = fingerprint_rows(local_row, local_cols, sort_comm);
+
+        long long sent, received, minor_faults, major_faults, minor_end;
+        trace_traffic(&sent, &received);
+        arena_page_faults(&minor_faults, &major_faults);
+        MPI_Barrier(sort_comm);
+        double start_time = MPI_Wtime();
+        if (options.isort) {
+            // The work of the application overlaps the sort: the next input, in pieces between tests
+            bitonic_request_t request;
+            bitonic_isort(&plan, &request, options.progress);
+            for (int lo = 0; lo < local_cols; lo += ISORT_PIECE) {
+                int len = (local_cols - lo < ISORT_PIECE) ? local_cols - lo : ISORT_PIECE;
+                generate_input(next_row + lo, len, first_index + lo, total_elements, sort_config.input_dist, sort_config.seed, 1);
+                bitonic_test(&request);
+            }
+            bitonic_wait(&request);
+        } else if (options.plan) {
+            bitonic_plan_execute(&plan);
+        } else {
+            sort_engine_run(local_row, &local_cols, total_cols, false, sort_comm);
+        }
+        double elapsed = MPI_Wtime() - start_time;
+        trace_traffic(&sent, &received);
+        arena_page_faults(&minor_end, &major_faults);
+        minor_faults = minor_end - minor_faults;
+
+        // A run lasts as long as its slowest process, the volume is summed over all of them
+        MPI_Allreduce(MPI_IN_PLACE, &elapsed, 1, MPI_DOUBLE, MPI_MAX, sort_comm);
+        MPI_Allreduce(MPI_IN_PLACE, &sent, 1, MPI_LONG_LONG, MPI_SUM, sort_comm);
+        MPI_Allreduce(MPI_IN_PLACE, &minor_faults, 1, MPI_LONG_LONG, MPI_SUM, sort_comm);
+        if (run >= 0) {
+            times[run] = elapsed * 1e3;
+            rates[run] = total_elements / elapsed / 1e6;
+            volumes[run] = sent / 1e6;
+            faults[run] = (double)minor_faults;
+        }
+
+        if (run == options.runs - 1) {
+            valid = validate_sort(local_row, local_cols, &input_fingerprint, sort_comm);
+        }
+    }
+
+    if (rank == 0) {
+        stats_t time = compute_stats(times, options.runs);
+        stats_t rate = compute_stats(rates, options.runs);
+        stats_t bytes = compute_stats(volumes, options.runs);
+        stats_t touched = compute_stats(faults, options.runs);
+        printf("Benchmark: %d processes, %lld %s %s elements, %d runs: median %.3f ms (p95 %.3f, min %.3f, stddev %.3f), %.1f Melements/s, %.2f MB exchanged, %.0f page faults%s\n",
+               size, total_elements, input_dist_names[sort_config.input_dist], ELEM_NAME, options.runs, time.median, time.p95, time.min, time.stddev,
+               rate.median, bytes.median, touched.median, valid ? "" : " [INVALID RESULT]");
+        write_row(&options, size, total_elements, &time, &rate, &bytes, valid);
+    }
+
+    if (options.plan) bitonic_plan_destroy(&plan);
+    if (next_row) arena_unmap(next_row, (size_t)total_cols * sizeof(elem_t));
+    bitonic_sort_release(sort_comm);
+    arena_release_all();
+    free(times);
+    free(rates);
+    free(volumes);
+    free(faults);
+    elem_mpi_type_release();
+    if (sort_comm != MPI_COMM_WORLD) MPI_Comm_free(&sort_comm);
+
+    MPI_Finalize();
+    return valid ? 0 : 1;
+}
@@ -0,0 +1,92 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <omp.h>
+#include <mpi.h>
+#include "config.h"
+
+#define ARENA_ALIGN         (2 << 20)   // Alignment and granularity of the mappings (one huge page)
+#define ARENA_TOUCH_BYTES   4096        // Stride of the first touch (one base page)
+
+
+// Row-sized buffers of a process, each one mapped once and reused by every later stage and sort
+typedef enum {
+    ARENA_ROW,          // The row being sorted (main program, benchmark)
+    ARENA_SPARE,        // Partner's row of the whole-row exchange, crossing elements of compare-split, sample sort bucket
+    ARENA_MERGE,        // Scratch of the parallel local sort and merges (`parallel_sort.h`)
+    ARENA_ELBOW,        // Scratch of `elbow_sort`
+    ARENA_RADIX,        // Scratch of `radix_sort`
+    ARENA_BLOCKS,       // One block per thread of the bounded merges (`bitonic_merge_bounded`)
+    ARENA_RING,         // Staging ring of the streaming exchange (`stream_exchange.h`)
+    ARENA_NUM_SLOTS
+} arena_slot_t;
+
+
+/**
+ * Returns the buffer of a slot, holding at least `bytes`. The slot is mapped on first use and
+ * only remapped when a larger size is asked for, in which case its content is lost: the slots
+ * hold scratch data between the calls that use them.
+ * The mappings are 2 MiB aligned and backed by huge pages as `--hugepages` says (transparent
+ * ones through `madvise`, or explicit ones from the hugetlb pool), and their pages are first
+ * touched by the `--threads` threads in the static partition that the sort kernels use, so
+ * every part of a row lands on the NUMA node of the thread that works on it.
+ * Aborts the processes (or exits, before MPI is initialized) if the mapping fails.
+ *
+ * @param slot   Slot of the buffer
+ * @param bytes  Minimum size of the buffer
+ *
+ * @return       Buffer of the slot
+ */
+void* arena_reserve(arena_slot_t slot, size_t bytes);
+
+
+/**
+ * Unmaps the buffer of a slot (the next `arena_reserve` maps it again).
+ *
+ * @param slot  Slot of the buffer
+ */
+void arena_release(arena_slot_t slot);
+
+
+/**
+ * Unmaps the buffers of every slot.
+ */
+void arena_release_all(void);
+
+
+/**
+ * Maps a private buffer the same way as the slots, for owners that keep it beyond the calls
+ * that use the slots (e.g. the scratch row of a plan).
+ *
+ * @param bytes  Size of the buffer
+ *
+ * @return       The buffer, NULL on failure
+ */
+void* arena_map(size_t bytes);
+
+
+/**
+ * Unmaps a buffer of `arena_map`.
+ *
+ * @param buffer  The buffer (NULL is ignored)
+ * @param bytes   Size given to `arena_map`
+ */
+void arena_unmap(void* buffer, size_t bytes);
+
+
+/**
+ * Returns the page faults of the process so far (`getrusage`), to report those of a phase.
+ *
+ * @param minor  Faults served without I/O (the first touch of every page)
+ * @param major  Faults that had to read from disk
+ */
+void arena_page_faults(long long* minor, long long* major);
+
+#endif
@@ -0,0 +1,166 @@
+#ifndef BITONIC_PLAN_H
+#define BITONIC_PLAN_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <mpi.h>
+#include "config.h"
+#include "arena.h"
+#include "utils.h"
+#include "row_sort_operations.h"
+#include "compare_split.h"
+#include "exchange_tuning.h"
+#include "chunk_exchange.h"
+#include "bitonic_sort.h"
+#include "trace.h"
+
+
+// One compare-exchange of the schedule
+typedef struct {
+    int  stage;             // Stage of the sort (1 to log2(rows))
+    int  step;              // Step of the stage
+    int  partner;           // Rank of the partner
+    bool keep_min;          // Side kept by this process (whole-row) / keep the low part (compare-split)
+    bool ascending;         // Direction of the stage (whole-row)
+    int  chunk_elements;    // Elements per chunk (whole-row)
+    int  first_request;     // Index of its first chunk in the persistent requests (whole-row)
+    int  source;            // Buffer holding the row before the exchange: 0 the caller's row, 1 the spare one (whole-row)
+} bitonic_plan_step_t;
+
+
+/**
+ * Reusable bitonic sort of same-shaped batches, in the style of an FFTW plan: everything that does
+ * not depend on the values is done once by `bitonic_plan_create`, so `bitonic_plan_execute` only
+ * sorts. The plan holds
+ *  - its own duplicate of the communicator, so its messages never match the caller's,
+ *  - the schedule: partner, direction and chunk size of every step,
+ *  - the scratch row, mapped from huge pages of its own (`arena_map`),
+ *  - with the whole-row exchange, a persistent send and receive (`MPI_Send_init` / `MPI_Recv_init`)
+ *    per chunk of every step. The buffers swap roles after every exchange and merge, in the same
+ *    order on every run, so each request is bound to the buffers that its step uses.
+ * The chunks always travel raw (`--compress` does not apply): persistent requests have fixed sizes.
+ * Like an FFTW plan it is bound to the row it was created with: refill the row, then execute
+ * (or start it with `bitonic_isort`).
+ */
+typedef struct {
+    MPI_Comm             comm;          // Duplicate of the caller's communicator
+    int                  rank;          // Rank of the current process
+    int                  rows;          // Number of processes
+    int                  cols;          // Elements per row
+    int                  stages;        // Stages of the network (log2 of the processes, rounded up)
+    int                  num_threads;   // Threads of the local sort and of the compare-exchanges
+    bool                 whole_row;     // Whole-row exchange (power of two of processes), compare-split otherwise
+    int                  num_steps;     // Compare-exchanges of this process
+    bitonic_plan_step_t* steps;         // Their schedule, in execution order
+    elem_t*              buffers[2];    // The caller's row and the scratch row
+    int                  num_requests;  // Persistent requests of each kind
+    MPI_Request*         sends;         // Persistent sends of every chunk of every step
+    MPI_Request*         recvs;         // Persistent receives of every chunk of every step
+    chunk_exchange_t     exchange;      // Progress engine of the whole-row exchanges
+} bitonic_plan_t;
+
+
+// Phases of a nonblocking sort, in order (the exchange phases repeat for every step)
+typedef enum {
+    ISORT_LOCAL_SORT,   // Initial local sort
+    ISORT_POST,         // Start the exchange of the current step, once the sends of the previous one are done
+    ISORT_RECEIVE,      // Compare-exchange the chunks of the current step as they land
+    ISORT_MERGE,        // Merge at the end of a stage, once its sends are done
+    ISORT_FINISH,       // Move the result into the caller's row
+    ISORT_DONE
+} isort_phase_t;
+
+
+/**
+ * Handle of a nonblocking sort (`bitonic_isort`). Its state machine only advances inside
+ * `bitonic_test` and `bitonic_wait`, or in a progress thread of its own.
+ */
+typedef struct {
+    bitonic_plan_t* plan;       // Plan being executed
+    isort_phase_t   phase;      // Next phase to run
+    int             step;       // Current step of the schedule
+    int             count;      // Elements of the row (compare-split)
+    int             elbow;      // Elbow of the last exchange of the stage
+    int             opposite;   // Opposite extreme of the last exchange of the stage
+    int             result;     // Buffer holding the sorted row
+    bool            threaded;   // Driven by a progress thread
+    pthread_t       thread;     // The progress thread
+    atomic_bool     done;       // Set by the progress thread once the sort is complete
+} bitonic_request_t;
+
+
+/**
+ * Creates a plan sorting `row` (`cols` elements on every process) across `comm`.
+ * Uses the whole-row exchange with a power of two of processes (unless `--exchange split`),
+ * the compare-split exchange otherwise; the chunk sizes are calibrated here (or taken from `--chunk`).
+ * Collective over `comm`.
+ *
+ * @param plan  Plan to fill
+ * @param row   Array of `cols` elements, sorted in place by every execution
+ * @param cols  Number of elements of every process
+ * @param comm  Communicator of the sort: one row per process, sorted in rank order
+ */
+void bitonic_plan_create(bitonic_plan_t* plan, elem_t* row, int cols, MPI_Comm comm);
+
+
+/**
+ * Sorts the current content of the plan's row across the processes (collective). On return every
+ * row holds `cols` elements, in ascending order across the processes in rank order.
+ *
+ * @param plan  Plan to execute
+ */
+void bitonic_plan_execute(bitonic_plan_t* plan);
+
+
+/**
+ * Starts sorting the plan's row and returns at once. The caller may work meanwhile, but must not
+ * touch the row before the sort completes, and a plan runs one sort at a time. The sort advances
+ *  - inside every `bitonic_test` and `bitonic_wait` of the processes (the local sort and the merges
+ *    run inside the call that reaches them), or
+ *  - with `progress_thread`, in a thread of its own, if MPI provides MPI_THREAD_MULTIPLE. The
+ *    thread runs the local sort and the merges through the scratch buffers of the process (the
+ *    arena slots of `parallel_sort.h`, `radix_sort.h` and `elbow_sort`) and records into the
+ *    process-wide trace: meanwhile the caller must not run any other sort of this library.
+ * Either way the sort is complete once `bitonic_test` returns true or `bitonic_wait` returns,
+ * and no other call is needed before the next `bitonic_isort` on the request.
+ * The compare-split exchange (see `bitonic_plan_create`) runs each compare-split to completion
+ * once started. Collective over the plan's communicator.
+ *
+ * @param plan             Plan to execute
+ * @param request          Handle of the sort
+ * @param progress_thread  Advance the sort in a progress thread
+ */
+void bitonic_isort(bitonic_plan_t* plan, bitonic_request_t* request, bool progress_thread);
+
+
+/**
+ * Advances the sort as far as it goes without waiting for a message.
+ *
+ * @param request  Handle of the sort
+ *
+ * @return         true once the sort is complete (the plan's row is sorted, and the progress
+ *                 thread, if any, has been joined)
+ */
+bool bitonic_test(bitonic_request_t* request);
+
+
+/**
+ * Completes the sort.
+ *
+ * @param request  Handle of the sort
+ */
+void bitonic_wait(bitonic_request_t* request);
+
+
+/**
+ * Frees the persistent requests, the scratch row and the communicator of the plan (collective).
+ *
+ * @param plan  Plan to destroy
+ */
+void bitonic_plan_destroy(bitonic_plan_t* plan);
+
+#endif
@@ -7,13 +7,23 @@
 #include <math.h>
 #include <string.h>
 #include <mpi.h>
+#include "config.h"
+#include "arena.h"
 #include "utils.h"
 #include "row_sort_operations.h"
+#include "compare_split.h"
+#include "shm_exchange.h"
+#include "exchange_tuning.h"
+#include "chunk_exchange.h"
+#include "stream_exchange.h"
+#include "trace.h"
 
 
 /**
- * Implements the distributed bitonic sort algorithm.
+ * Implements the distributed bitonic sort algorithm on `MPI_COMM_WORLD`.
  * Each process handles a single row and communicates with the rest as needed.
+ * With `--exchange split` the rows are kept sorted and partners compare-split them,
+ * moving only the elements that cross.
  * 
  * @param local_row  Array containing the local portion of the matrix (the local array)
  * @param rows       Total number of rows(processes)
@@ -21,6 +31,48 @@
  * @param rank       Rank of the current process
  * 
  */
-void bitonic_sort(int* local_row, int rows, int cols, int rank);
+void bitonic_sort(elem_t* local_row, int rows, int cols, int rank);
+
+
+/**
+ * Distributed bitonic sort of any number of elements over any number of processes.
+ * Each row may hold fewer than `capacity` elements and `rows` does not have to be a power of two:
+ * the missing elements and rows are virtual +infinity padding, which is never stored or sent.
+ * Uses the whole-row exchange when it applies (every row full and a power of two of rows),
+ * the compare-split exchange otherwise.
+ *
+ * On return the data is sorted across the processes in rank order: every row is full except
+ * the last non-empty one, and the rows after it are empty.
+ *
+ * @param local_row  Array of `capacity` elements, the first `*count` of which hold the local data
+ * @param count      Number of elements of the current process (updated)
+ * @param capacity   Number of elements every row can hold (at least the largest initial count)
+ * @param presorted  The local data is already sorted in ascending order (skips the local sort)
+ * @param comm       Communicator of the sort: one row per process, sorted in rank order
+ */
+void bitonic_sort_any(elem_t* local_row, int* count, int capacity, bool presorted, MPI_Comm comm);
+
+
+/**
+ * Frees the setup that the whole-row exchange caches on a communicator (the calibrated chunk
+ * sizes and the shared window of the node), which is otherwise freed with the communicator. Collective over `comm`.
+ *
+ * @param comm  Communicator of the previous sorts
+ */
+void bitonic_sort_release(MPI_Comm comm);
+
+
+/**
+ * Computes the partner of a row in the exchange schedule.
+ *
+ * @param rank   Rank of the current process
+ * @param stage  Stage of the sort (1 to log2(rows))
+ * @param step   Step of the stage (stage - 1 down to 0)
+ * @param flip   If true, use the "flip" network of the compare-split exchange, where the
+ *               first step of every stage pairs each row with its mirror inside the block
+ *
+ * @return       Rank of the partner
+ */
+int bitonic_partner(int rank, int stage, int step, bool flip);
 
 #endif
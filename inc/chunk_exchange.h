@@ -0,0 +1,240 @@
+#ifndef CHUNK_EXCHANGE_H
+#define CHUNK_EXCHANGE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sched.h>
+#include <time.h>
+#include <mpi.h>
+#include "config.h"
+#include "row_sort_operations.h"
+#include "exchange_tuning.h"
+#include "wire_codec.h"
+#include "trace.h"
+
+#define PARRIVED_SPINS      16      // Empty polls of the partitions before the receiving thread backs off
+#define PARRIVED_MAX_SLEEP  65536   // Longest pause between two polls in nanoseconds (doubles from 1 us)
+
+
+/**
+ * Partitioned requests of the whole-row exchanges (`--partitioned`), kept across the exchanges and
+ * the sorts: the request of a step is created by its first exchange and only restarted by the next
+ * ones. The two buffers of the sort swap roles after every exchange, so a step has one pair of
+ * requests per direction, created in the same order on both partners.
+ */
+typedef struct {
+    elem_t*     buffers[2];                         // Buffers the requests are bound to (the row before the first step, the spare one)
+    MPI_Request sends[MAX_EXCHANGE_STEPS][2];       // Send of every step from `buffers[i]` (MPI_REQUEST_NULL until created)
+    MPI_Request recvs[MAX_EXCHANGE_STEPS][2];       // Matching receive into `buffers[i ^ 1]`
+} chunk_partitions_t;
+
+
+/**
+ * Progress engine of the chunked whole-row exchanges.
+ * Every chunk is compare-exchanged as soon as it lands, in completion order: the kept elements are
+ * written over the received chunk, so the own row is only read and its sends may still be in flight.
+ * Those sends (the tail of the exchange) are only completed when their row is about to be overwritten.
+ */
+typedef struct {
+    MPI_Request* sends;             // Sends of the point-to-point exchanges
+    MPI_Request* in_flight;         // Pending sends of the last exchange (`sends` or persistent requests of the caller)
+    int          pending;           // Number of them
+    MPI_Request* recvs;             // Receives of the current exchange
+    int*         indices;           // Completed receives returned by `MPI_Waitsome`
+    int*         chunk_elbow;       // Elbow of every chunk (-1 if the chunk is empty)
+    int*         chunk_opposite;    // Opposite extreme of every chunk
+    bool*        arrived;           // Partitions already handed over (partitioned requests)
+    MPI_Status*  statuses;          // Statuses of the completed receives (compressed exchanges)
+    bool         compressed;        // The chunks of the current exchange travel through the wire codec
+    char*        wire_send;         // Encoded chunks of the own row, `wire_stride` bytes apart
+    char*        wire_recv;         // Encoded chunks of the partner's row
+    size_t       wire_stride;       // Room of one encoded chunk (`wire_bound`)
+    size_t       wire_capacity;     // Bytes of each wire buffer
+
+    // Exchange of `chunk_exchange_post` being polled
+    MPI_Request*  landing;          // Its receives
+    const elem_t* row;              // Own row, sent to the partner
+    elem_t*       spare;            // Receives the partner's row, then holds the kept elements
+    int           cols;             // Number of elements in each row
+    int           chunk_elements;   // Elements per chunk
+    int           chunk_count;      // Number of chunks
+    int           landed;           // Chunks already compare-exchanged
+    bool          keep_min;         // Kept side of every pair
+    bool          find_min;         // Direction of the elbow search
+} chunk_exchange_t;
+
+
+/**
+ * Allocates the engine for exchanges of up to `MAX_CHUNKS` chunks.
+ *
+ * @param ex    Engine to initialize
+ * @param rank  Rank of the current process
+ * @param comm  Communicator of the sort
+ */
+void chunk_exchange_init(chunk_exchange_t* ex, int rank, MPI_Comm comm);
+
+
+/**
+ * Empties a set of partitioned requests.
+ *
+ * @param parts  Requests to initialize
+ */
+void chunk_partitions_init(chunk_partitions_t* parts);
+
+
+/**
+ * Binds the partitioned requests to the two buffers of a sort (collective over `comm`). If any
+ * process sorts in other buffers than the previous time, every process frees its requests, and
+ * the next exchanges create them again.
+ *
+ * @param parts  Requests of the sort
+ * @param row    Buffer holding the row before the first step
+ * @param spare  The other buffer
+ * @param comm   Communicator of the sort
+ */
+void chunk_partitions_bind(chunk_partitions_t* parts, elem_t* row, elem_t* spare, MPI_Comm comm);
+
+
+/**
+ * Frees the partitioned requests (none may be active).
+ *
+ * @param parts  Requests to free
+ */
+void chunk_partitions_free(chunk_partitions_t* parts);
+
+
+/**
+ * Exchanges `row` with the partner in chunks of `chunk_elements` and keeps one side of every pair.
+ * On return the kept elements are in `spare` (the partner's row is consumed), while the sends of
+ * `row` may still be pending: call `chunk_exchange_complete` before writing to `row`.
+ * The receiving thread hands every landed chunk to the other threads, so only it calls MPI.
+ *
+ * @param ex              Engine (its previous sends must not read from `spare`)
+ * @param row             Own row, sent to the partner
+ * @param spare           Receives the partner's row, then holds the kept elements
+ * @param cols            Number of elements in each row
+ * @param chunk_elements  Elements per chunk
+ * @param max_ratio       Chunks travel through the wire codec if > 0, bit-packed when that takes at most
+ *                        this fraction of their size (see `chunk_plan_t`); 0: raw chunks
+ * @param partner         Rank of the partner
+ * @param tag             Tag of the exchange (below 2^16, the chunk index goes above it)
+ * @param parts           Partitioned requests of the sort, bound to `row` and `spare` (`chunk_partitions_bind`),
+ *                        or NULL for point-to-point chunks. Used by the raw exchanges whose chunk size divides the row
+ * @param step            Step of the exchange (slot of its partitioned requests)
+ * @param keep_min        If true keep the element-wise minimum, the maximum otherwise
+ * @param find_min        Direction of the elbow search (if `elbow` is not NULL)
+ * @param elbow           If not NULL, receives the index of the first min/max kept element
+ * @param opposite        If not NULL, receives the index of the first opposite extreme
+ * @param num_threads     Threads compare-exchanging (and decoding) the landed chunks
+ * @param comm            Communicator of the sort
+ */
+void chunk_exchange_run(chunk_exchange_t* ex, const elem_t* row, elem_t* spare, int cols, int chunk_elements,
+                        double max_ratio, int partner, int tag, chunk_partitions_t* parts, int step, bool keep_min,
+                        bool find_min, int* elbow, int* opposite, int num_threads, MPI_Comm comm);
+
+
+/**
+ * Creates the persistent requests (`MPI_Send_init` / `MPI_Recv_init`) of one chunked exchange between
+ * fixed buffers, with the chunks and tags of `chunk_exchange_run`. Free them with `MPI_Request_free`.
+ *
+ * @param sends           Receives the `ceil(cols / chunk_elements)` send requests
+ * @param recvs           Receives the matching receive requests
+ * @param row             Own row, sent to the partner
+ * @param spare           Receives the partner's row
+ * @param cols            Number of elements in each row
+ * @param chunk_elements  Elements per chunk
+ * @param partner         Rank of the partner
+ * @param tag             Tag of the exchange (below 2^16, the chunk index goes above it)
+ * @param comm            Communicator of the sort
+ *
+ * @return                Number of chunks (requests of each kind)
+ */
+int chunk_exchange_persistent_init(MPI_Request* sends, MPI_Request* recvs, const elem_t* row, elem_t* spare, int cols,
+                                   int chunk_elements, int partner, int tag, MPI_Comm comm);
+
+
+/**
+ * Same as `chunk_exchange_run` (without compression), on the persistent requests of `chunk_exchange_persistent_init`:
+ * nothing is set up, the requests are only started. `row` and `spare` must be the buffers they
+ * were created with, and `sends` stays pending until `chunk_exchange_complete`.
+ *
+ * @param ex              Engine (its previous sends must not read from `spare`)
+ * @param sends           Persistent send requests of the exchange
+ * @param recvs           Persistent receive requests of the exchange
+ * @param row             Own row, sent to the partner
+ * @param spare           Receives the partner's row, then holds the kept elements
+ * @param cols            Number of elements in each row
+ * @param chunk_elements  Elements per chunk
+ * @param keep_min        If true keep the element-wise minimum, the maximum otherwise
+ * @param find_min        Direction of the elbow search (if `elbow` is not NULL)
+ * @param elbow           If not NULL, receives the index of the first min/max kept element
+ * @param opposite        If not NULL, receives the index of the first opposite extreme
+ * @param num_threads     Threads compare-exchanging the landed chunks
+ */
+void chunk_exchange_start(chunk_exchange_t* ex, MPI_Request* sends, MPI_Request* recvs, const elem_t* row, elem_t* spare,
+                          int cols, int chunk_elements, bool keep_min, bool find_min, int* elbow, int* opposite,
+                          int num_threads);
+
+
+/**
+ * Starts the persistent requests of `chunk_exchange_persistent_init` and returns at once: the
+ * exchange advances with `chunk_exchange_poll`. The previous sends must be complete
+ * (`chunk_exchange_test_sends` or `chunk_exchange_complete`).
+ *
+ * @param ex              Engine
+ * @param sends           Persistent send requests of the exchange
+ * @param recvs           Persistent receive requests of the exchange
+ * @param row             Own row, sent to the partner
+ * @param spare           Receives the partner's row, then holds the kept elements
+ * @param cols            Number of elements in each row
+ * @param chunk_elements  Elements per chunk
+ * @param keep_min        If true keep the element-wise minimum, the maximum otherwise
+ * @param find_min        Direction of the elbow search
+ */
+void chunk_exchange_post(chunk_exchange_t* ex, MPI_Request* sends, MPI_Request* recvs, const elem_t* row, elem_t* spare,
+                         int cols, int chunk_elements, bool keep_min, bool find_min);
+
+
+/**
+ * Compare-exchanges the chunks of the posted exchange that have landed since the last call.
+ * Without `blocking` it returns at once if none has, otherwise it waits for at least one.
+ *
+ * @param ex           Engine
+ * @param blocking     Wait for a chunk instead of testing
+ * @param elbow        If not NULL, receives the index of the first min/max kept element once all landed
+ * @param opposite     If not NULL, receives the index of the first opposite extreme once all landed
+ * @param num_threads  Threads compare-exchanging the landed chunks
+ *
+ * @return             true once every chunk has landed and been compare-exchanged
+ */
+bool chunk_exchange_poll(chunk_exchange_t* ex, bool blocking, int* elbow, int* opposite, int num_threads);
+
+
+/**
+ * Tests the pending sends of the last exchange without blocking.
+ *
+ * @param ex  Engine
+ *
+ * @return    true if no send is pending anymore
+ */
+bool chunk_exchange_test_sends(chunk_exchange_t* ex);
+
+
+/**
+ * Completes the pending sends of the last exchange.
+ *
+ * @param ex  Engine
+ */
+void chunk_exchange_complete(chunk_exchange_t* ex);
+
+
+/**
+ * Completes the pending sends and releases the engine.
+ *
+ * @param ex  Engine to free
+ */
+void chunk_exchange_free(chunk_exchange_t* ex);
+
+#endif
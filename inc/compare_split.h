@@ -0,0 +1,63 @@
+#ifndef COMPARE_SPLIT_H
+#define COMPARE_SPLIT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <mpi.h>
+#include "sort_key.h"
+#include "trace.h"
+
+#define SPLIT_PROBES  64    // Splitters exchanged per round of the cut point search
+
+
+// Key at a position of a sorted row (the row does not have to be in memory)
+typedef sort_key_t (*compare_split_key_t)(const void* row, int position);
+
+
+/**
+ * Compare-split between two partners holding ascending sorted rows.
+ * Both rows have the same `capacity`; a row holding fewer elements is treated as if it was
+ * padded with +infinity up to the capacity, without the padding ever being stored or sent.
+ * Afterwards the `keep_low` side holds the smallest `capacity` elements of the union and
+ * the other side the rest, both still sorted ascending.
+ *
+ * The partners first search the cut point (the number of elements that cross) by
+ * exchanging rounds of `SPLIT_PROBES` splitters, then swap only the crossing elements
+ * and merge them in place. If the ranges do not overlap nothing else is sent.
+ *
+ * @param row        Ascending sorted row of the current process (updated in place)
+ * @param buffer     Receive buffer of at least `capacity` elements
+ * @param capacity   Number of elements each row can hold
+ * @param count      Number of elements in the row (updated)
+ * @param partner    Rank of the partner process
+ * @param keep_low   If true, keep the smaller part; if false, keep the larger part
+ * @param tag        Message tag of this exchange
+ * @param comm       Communicator of the two partners
+ *
+ * @return           Number of elements sent to the partner
+ */
+int compare_split(elem_t* row, elem_t* buffer, int capacity, int* count, int partner, bool keep_low, int tag, MPI_Comm comm);
+
+
+/**
+ * First step of `compare_split`: finds the cut point (the number of slots that cross) together
+ * with the partner. Only the probed keys of the row are read, through `key_at`.
+ *
+ * @param key_at     Reads the key at a position of the row
+ * @param row        Ascending sorted row of the current process, passed to `key_at`
+ * @param capacity   Number of elements each row can hold
+ * @param count      Number of elements in the row
+ * @param partner    Rank of the partner process
+ * @param keep_low   If true, this side keeps the smaller part
+ * @param tag        Message tag of this exchange
+ * @param comm       Communicator of the two partners
+ *
+ * @return           Cut point: the top `cut` slots of the low row and the bottom `cut` of the high row cross
+ */
+int compare_split_cut(compare_split_key_t key_at, const void* row, int capacity, int count, int partner, bool keep_low,
+                      int tag, MPI_Comm comm);
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+
+
+// Exchange performed between partner rows at every step
+typedef enum {
+    EXCHANGE_FULL,      // Rows are swapped whole and compared element-wise (followed by the elbow merge)
+    EXCHANGE_SPLIT,     // Rows are kept sorted and only the elements that cross between the partners move
+    EXCHANGE_STREAM     // Whole-row exchange through a ring of staging blocks, merged in place (about one row of memory)
+} exchange_mode_t;
+
+
+// Compression of the whole-row exchanges
+typedef enum {
+    COMPRESS_OFF,       // Rows travel raw
+    COMPRESS_ON,        // Every chunk that shrinks travels bit-packed (see `wire_codec.h`)
+    COMPRESS_AUTO       // Only on the links slower than the codec, and for the chunks that shrink enough to pay for it
+} compress_mode_t;
+
+
+// Pages backing the row buffers (see `arena.h`)
+typedef enum {
+    HUGEPAGES_OFF,      // Base pages only
+    HUGEPAGES_THP,      // Transparent huge pages, asked for with `madvise`
+    HUGEPAGES_EXPLICIT  // Huge pages of the hugetlb pool, transparent ones when it is empty
+} hugepages_mode_t;
+
+
+// Distributed sort algorithm
+typedef enum {
+    ENGINE_BITONIC,     // Bitonic network of pairwise exchanges
+    ENGINE_SAMPLE,      // Sample sort: splitters from regular samples and a single all-to-all
+    ENGINE_AUTO         // Picked by a cost model from the processes, the elements and the measured links
+} sort_engine_t;
+
+
+// Distribution of the generated input keys
+typedef enum {
+    INPUT_UNIFORM,          // Random keys over the whole key range
+    INPUT_SORTED,           // Already ascending over all processes
+    INPUT_REVERSED,         // Descending over all processes
+    INPUT_NEARLY_SORTED,    // Ascending, with a few keys out of place
+    INPUT_ZIPF,             // Duplicate heavy: few keys take most of the input
+    INPUT_EQUAL,            // A single key
+    INPUT_ORGAN_PIPE,       // Ascending over the first half, descending over the second one
+    INPUT_NUM_DISTS
+} input_dist_t;
+
+extern const char* const input_dist_names[INPUT_NUM_DISTS];
+
+
+/**
+ * Runtime settings of the sort.
+ * Every field is first read from its environment variable and can then be
+ * overridden by the matching command line option.
+ */
+typedef struct {
+    int num_threads;                // Threads used inside each rank (BITONIC_THREADS, --threads)
+    sort_engine_t engine;           // Distributed sort algorithm (BITONIC_ENGINE, --engine)
+    exchange_mode_t exchange_mode;  // Exchange between partners (BITONIC_EXCHANGE, --exchange)
+    bool partitioned;               // MPI-4 partitioned requests for the chunks (BITONIC_PARTITIONED, --partitioned)
+    long long chunk_bytes;          // Bytes per chunk of the whole-row exchanges, 0: calibrated per step (BITONIC_CHUNK, --chunk)
+    compress_mode_t compress;       // Compression of the whole-row exchanges (BITONIC_COMPRESS, --compress)
+    long long total_elements;       // Total elements over all processes, 0: 2^q per process (BITONIC_ELEMENTS, --elements)
+    input_dist_t input_dist;        // Distribution of the generated keys (BITONIC_DIST, --dist)
+    long long seed;                 // Seed of the input generator (BITONIC_SEED, --seed)
+    const char* input_path;         // Raw binary file of keys to sort instead of generating them, NULL: none (BITONIC_INPUT, --input)
+    const char* output_path;        // File receiving the sorted elements, NULL: none (BITONIC_OUTPUT, --output)
+    bool io_overlap;                // Sort the blocks of the input while the next ones are read (BITONIC_IO_OVERLAP, --io-overlap)
+    long long memory_budget;        // Bytes of buffers per process of the external sort, 0: rows sorted in memory (BITONIC_MEMORY, --memory)
+    const char* scratch_dir;        // Directory of the scratch files of the external sort, NULL: $TMPDIR or /tmp (BITONIC_SCRATCH, --scratch)
+    hugepages_mode_t hugepages;     // Pages of the row buffers (BITONIC_HUGEPAGES, --hugepages)
+    bool use_shared_memory;         // Exchange in place with partners on the same node (BITONIC_SHM, --shm)
+    bool remap_ranks;               // Renumber the processes along the node/socket hierarchy (BITONIC_REMAP, --remap)
+    const char* trace_prefix;       // Output files of the per-stage trace, NULL: no trace (BITONIC_TRACE, --trace)
+    bool trace_counters;            // Hardware counters in the trace events (BITONIC_TRACE_COUNTERS, --trace-counters)
+} sort_config_t;
+
+extern sort_config_t sort_config;
+
+
+/**
+ * Loads the runtime settings from the environment and the command line.
+ * Recognized options are removed from `argv`, so that only the positional
+ * arguments are left for the caller.
+ *
+ * @param argc  Pointer to the argument count (updated)
+ * @param argv  Argument vector (compacted in place)
+ * @param rank  Rank of the current process (only rank 0 reports errors)
+ *
+ * @return      true if every option was valid, false otherwise
+ */
+bool config_init(int* argc, char* argv[], int rank);
+
+
+/**
+ * Prints the supported options.
+ *
+ * @param prog  Name of the executable
+ */
+void config_print_usage(const char* prog);
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef EXCHANGE_TUNING_H
+#define EXCHANGE_TUNING_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <mpi.h>
+#include "config.h"
+#include "row_sort_operations.h"
+#include "shm_exchange.h"
+#include "wire_codec.h"
+
+#define MAX_EXCHANGE_STEPS  30          // Steps of the largest schedule (log2 of the processes)
+#define MAX_CHUNKS          1024        // Chunks per exchange (the chunk index is stored above the 16 bits of stage/step of the tag)
+#define MIN_CHUNK_BYTES     (16 << 10)  // Smallest chunk picked by the calibration
+#define TUNING_PROBE_BYTES  (1 << 20)   // Largest message of the bandwidth probe
+#define TUNING_REPEATS      4           // Probes per measurement (the fastest one is kept)
+#define COMPARE_PROBE       (1 << 15)   // Elements of the compare-exchange speed probe
+
+
+/**
+ * Chunking of the whole-row exchanges: at step `s` the partners are 2^s ranks apart, so each step
+ * crosses its own kind of link (same socket, same node, network) and gets its own chunk size.
+ */
+typedef struct {
+    int    steps;                               // Steps of the schedule (log2 of the processes)
+    bool   tuned;                               // true: sizes from the calibration, false: from `--chunk`
+    int    chunk_elements[MAX_EXCHANGE_STEPS];  // Elements per chunk of the exchanges at each step
+    double latency[MAX_EXCHANGE_STEPS];         // Seconds per message (slowest pair, 0 if no pair sent messages)
+    double bandwidth[MAX_EXCHANGE_STEPS];       // Bytes per second (slowest pair)
+    double compare_time;                        // Seconds per compare-exchanged element (slowest process)
+    double codec_speed;                         // Raw bytes per second through the wire codec (slowest process, 0 if not probed)
+    double max_ratio[MAX_EXCHANGE_STEPS];       // Largest encoded / raw size of a chunk worth packing at each step, 0: raw exchange
+} chunk_plan_t;
+
+
+/**
+ * Fastest of `TUNING_REPEATS` exchanges of `bytes` with a partner.
+ *
+ * @param send     Buffer of at least `bytes` to send
+ * @param recv     Buffer of at least `bytes` to receive into
+ * @param bytes    Message size
+ * @param partner  Rank of the partner (which must probe back with the same size)
+ * @param comm     Communicator of the partners
+ *
+ * @return         Seconds of the round trip
+ */
+double exchange_probe(char* send, char* recv, int bytes, int partner, MPI_Comm comm);
+
+
+/**
+ * Picks the chunk size of every step (collective over `comm`, identical on every process).
+ * With `sort_config.chunk_bytes` set, every step uses it. Otherwise every step probes the latency
+ * and bandwidth of its partner (except the ones exchanging through shared memory) and the speed of
+ * the compare-exchange, then splits the row into k = sqrt(min(transfer, compare) / latency) chunks:
+ * the exchange and the compare-exchange overlap, and only the last chunk of the shorter one is not
+ * hidden, against one latency per chunk.
+ * With `--compress auto` it also probes the speed of the wire codec: a step whose link is slower
+ * compresses every chunk that saves more transfer time than the codec costs, i.e. packs to at most
+ * 1 - bandwidth / codec speed of its size (and only if that saves at least WIRE_MIN_SAVING).
+ * `--compress on` packs every chunk that shrinks on every step between nodes.
+ *
+ * @param plan          Plan to fill
+ * @param cols          Number of elements in each row
+ * @param comm_threads  Threads completing chunks concurrently (at least one chunk each)
+ * @param shm           Shared memory context of the sort (map of the node, and its window if any), or NULL
+ * @param comm          Communicator of the sort (a power of two of processes)
+ */
+void chunk_plan_create(chunk_plan_t* plan, int cols, int comm_threads, const shm_context_t* shm, MPI_Comm comm);
+
+
+/**
+ * Prints the chunk size of every step and the measurements behind it (rank 0 only).
+ *
+ * @param plan  Plan to print
+ * @param cols  Number of elements in each row
+ * @param rank  Rank of the current process
+ */
+void chunk_plan_report(const chunk_plan_t* plan, int cols, int rank);
+
+#endif
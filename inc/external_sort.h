@@ -0,0 +1,51 @@
+#ifndef EXTERNAL_SORT_H
+#define EXTERNAL_SORT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <mpi.h>
+#include "config.h"
+#include "arena.h"
+#include "utils.h"
+#include "parallel_sort.h"
+#include "compare_split.h"
+#include "bitonic_sort.h"
+#include "generator.h"
+#include "file_io.h"
+#include "trace.h"
+#include "validation.h"
+
+#define EXTERNAL_MIN_BLOCK    (256 << 10)   // Smallest block (bytes) of a merged run
+#define EXTERNAL_MAX_FAN_IN   64            // Most runs merged by one pass
+#define EXTERNAL_NET_BLOCKS   6             // Blocks of a compare-split: 2 prefetched per input stream, 2 for the output
+
+
+/**
+ * Out-of-core sort (`--memory`): the rows only live in scratch files of `--scratch`, and every phase
+ * streams them through buffers carved from a budget of `sort_config.memory_budget` bytes per process.
+ *  1. Runs: the slice of the input (`--input` or the generator) is read in pieces of half the budget,
+ *     each one is sorted through the other half and spilled to scratch.
+ *  2. Merge: passes of k-way merges turn the runs into one sorted row on scratch.
+ *  3. Network: the compare-split bitonic network of `--exchange split`, where each compare-split
+ *     streams the crossing elements to the partner block by block, then merges the kept part with them.
+ *  4. Output: the sorted rows are validated (order and fingerprint of the input) and written to
+ *     `--output` (if set) in rank order.
+ * Every scratch read is nonblocking and prefetches the next block while the current one is consumed.
+ * Collective over `comm`, prints the report of the phases on rank 0.
+ *
+ * @param total     Number of elements of the whole input
+ * @param capacity  Number of elements every row can hold (at least the largest count)
+ * @param count     Number of elements of this process
+ * @param first     Global position of its first element in the input
+ * @param comm      Communicator of the sort: one row per process, sorted in rank order
+ *
+ * @return          true on every process if the result is sorted across the processes
+ */
+bool external_sort(long long total, int capacity, int count, long long first, MPI_Comm comm);
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef FILE_IO_H
+#define FILE_IO_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <mpi.h>
+#include "config.h"
+#include "utils.h"
+#include "parallel_sort.h"
+
+#define IO_BLOCK_BYTES  (16 << 20)  // Bytes per collective read/write, block boundaries fall on multiples of it in the file
+
+
+/**
+ * Aborts with the MPI error message if an I/O call failed.
+ *
+ * @param err   Return code of the MPI-IO call
+ * @param what  Operation, e.g. "Reading"
+ * @param path  File of the operation
+ * @param comm  Communicator to abort
+ */
+void file_io_check(int err, const char* what, const char* path, MPI_Comm comm);
+
+
+/**
+ * Returns the number of keys of a raw binary file (collective over `comm`).
+ * Aborts if the file cannot be opened or its size is not a multiple of the key size.
+ *
+ * @param path  File of `sort_key_t` keys in native byte order
+ * @param comm  Communicator of the sort
+ */
+long long file_io_count(const char* path, MPI_Comm comm);
+
+
+/**
+ * Reads the keys `[first, first + count)` of a raw binary file with collective reads of aligned
+ * blocks (collective over `comm`). With a payload, the id of every element is its position in the file.
+ * With `presort`, the next block is read (nonblocking) while the one that arrived is sorted, and the
+ * sorted blocks are merged at the end: the row is then sorted in ascending order.
+ *
+ * @param path      File of `sort_key_t` keys
+ * @param row       Output row of at least `count` elements
+ * @param count     Number of keys of this process
+ * @param first     Position of its first key in the file
+ * @param presort   If true, sort the row in ascending order while reading it
+ * @param scratch   Scratch of `count` elements for the presort, NULL: the module's own (`parallel_sort.h`)
+ * @param comm      Communicator of the sort
+ *
+ * @return          Seconds spent in the whole read (the slowest process)
+ */
+double file_io_read(const char* path, elem_t* row, int count, long long first, bool presort, elem_t* scratch, MPI_Comm comm);
+
+
+/**
+ * Writes the rows in rank order (the sorted result) into a new file with collective writes of
+ * aligned blocks (collective over `comm`). The elements are written as they are stored: the keys,
+ * or the (key, id) pairs with a payload.
+ *
+ * @param path   Output file (created or truncated)
+ * @param row    Local row
+ * @param count  Number of elements of this process
+ * @param comm   Communicator of the sort
+ *
+ * @return       Seconds spent in the whole write (the slowest process)
+ */
+double file_io_write(const char* path, const elem_t* row, int count, MPI_Comm comm);
+
+#endif
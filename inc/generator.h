@@ -0,0 +1,42 @@
+#ifndef GENERATOR_H
+#define GENERATOR_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <math.h>
+#include "config.h"
+#include "sort_key.h"
+
+#define NEARLY_SORTED_RATE  64          // One key in 64 is out of place in the nearly sorted input
+#define ZIPF_VALUES         (1 << 20)   // Distinct keys of the Zipf input (rank k drawn with probability ~ 1/k)
+#define GOLDEN_GAMMA        0x9E3779B97F4A7C15ULL   // Counter increment of splitmix64
+
+
+// Finalizer of splitmix64: a bijective mix of the 64 bits, so distinct counters give distinct outputs
+static inline uint64_t mix64(uint64_t x) {
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+
+/**
+ * Generates the elements `[first, first + cols)` of a global input of `total` elements.
+ * Every key comes from a counter-based generator (splitmix64 of the seed and the global position),
+ * so the input only depends on `seed` and `total`: not on the number of processes or threads,
+ * nor on the order of generation. With a payload, the id of every element is its global position.
+ *
+ * @param row          Output row of `cols` elements
+ * @param cols         Number of elements to generate
+ * @param first        Global position of the first element
+ * @param total        Number of elements of the whole input
+ * @param dist         Distribution of the keys
+ * @param seed         Seed of the generator
+ * @param num_threads  Number of threads to use
+ */
+void generate_input(elem_t* row, int cols, long long first, long long total, input_dist_t dist,
+                    unsigned long long seed, int num_threads);
+
+#endif
@@ -0,0 +1,69 @@
+#ifndef PAIRWISE_KERNELS_H
+#define PAIRWISE_KERNELS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include "sort_key.h"
+
+
+/**
+ * Branchless compare-exchange kernel between two row slices.
+ * Ascending kernels leave the element-wise minimum in `row1` and the maximum in `row2`,
+ * descending kernels do the opposite. With payloads the pairs are compared by key and
+ * moved as a whole.
+ *
+ * @param row1  First row slice
+ * @param row2  Second row slice
+ * @param cols  Number of elements in each slice
+ */
+typedef void (*pairwise_kernel_t)(elem_t* row1, elem_t* row2, int cols);
+
+
+/**
+ * Compare-exchange kernel that only keeps the `row1` side of every pair, written over `row2`
+ * (`row1` is only read, so it can still be in flight as a send buffer). On ties the `row1`
+ * element is kept, as with `pairwise_kernel_t`.
+ *
+ * @param row1  Own row slice (read only)
+ * @param row2  Partner's row slice, overwritten with the kept elements
+ * @param cols  Number of elements in each slice
+ */
+typedef void (*pairwise_keep_kernel_t)(const elem_t* row1, elem_t* row2, int cols);
+
+
+/**
+ * Returns the kernel of a specific instruction set.
+ *
+ * @param isa        One of "avx512", "avx2", "sse4.1" or "scalar"
+ * @param ascending  Direction the kernel is specialized for
+ *
+ * @return           The kernel, or NULL if the ISA is unknown, has no kernel for the element type
+ *                   of the build or is not supported by this CPU
+ */
+pairwise_kernel_t pairwise_kernel_get(const char* isa, bool ascending);
+
+
+/**
+ * Returns the fastest kernel supported by this CPU.
+ *
+ * @param ascending  Direction the kernel is specialized for
+ */
+pairwise_kernel_t pairwise_kernel_select(bool ascending);
+
+
+/**
+ * Returns the fastest keep kernel supported by this CPU.
+ *
+ * @param ascending  Direction: keep the minimum (true) or the maximum (false) of every pair
+ */
+pairwise_keep_kernel_t pairwise_keep_kernel_select(bool ascending);
+
+
+/**
+ * Returns the name of the instruction set used by `pairwise_kernel_select`.
+ */
+const char* pairwise_kernel_isa(void);
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef PARALLEL_SORT_H
+#define PARALLEL_SORT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <omp.h>
+#include "arena.h"
+#include "radix_sort.h"
+
+#define MIN_ELEMENTS_PER_THREAD  (1 << 14)   // Below this, extra threads cost more than they save
+
+
+/**
+ * Finds the merge path split of a diagonal: the number of elements taken from `a`
+ * when the first `diag` outputs of merging `a` and `b` are produced.
+ * Ties are resolved in favor of `a`, so the merge is stable.
+ *
+ * @param a          First sorted run
+ * @param len_a      Size of the first run
+ * @param b          Second sorted run
+ * @param len_b      Size of the second run
+ * @param diag       Number of merged outputs (0 <= diag <= len_a + len_b)
+ * @param ascending  Order of both runs
+ *
+ * @return           Number of elements consumed from `a`
+ */
+int merge_path_partition(const elem_t* a, int len_a, const elem_t* b, int len_b, int diag, bool ascending);
+
+
+/**
+ * Merges two sorted runs into `dst` without branching on the data.
+ *
+ * @param a          First sorted run
+ * @param len_a      Size of the first run
+ * @param b          Second sorted run
+ * @param len_b      Size of the second run
+ * @param dst        Output buffer of `len_a + len_b` elements
+ * @param ascending  Order of both runs (and of the output)
+ */
+void merge_runs(const elem_t* a, int len_a, const elem_t* b, int len_b, elem_t* dst, bool ascending);
+
+
+/**
+ * Sorts a row with several threads: every thread radix sorts its own slice, then the
+ * sorted slices are merged pairwise, with each merge split evenly across the threads
+ * through merge path partitioning.
+ * The scratch buffer is owned by the module and reused across calls.
+ *
+ * @param row          Array representing the row to be sorted
+ * @param cols         Number of elements in the row
+ * @param ascending    If true, sort in ascending order; if false, sort in descending order
+ * @param num_threads  Number of threads to use
+ */
+void parallel_local_sort(elem_t* row, int cols, bool ascending, int num_threads);
+
+
+/**
+ * Same as `parallel_local_sort`, through a caller-provided scratch buffer (e.g. one carved from
+ * a memory budget).
+ *
+ * @param row          Array representing the row to be sorted
+ * @param scratch      Scratch buffer of at least `cols` elements
+ * @param cols         Number of elements in the row
+ * @param ascending    If true, sort in ascending order; if false, sort in descending order
+ * @param num_threads  Number of threads to use
+ */
+void parallel_local_sort_buffered(elem_t* row, elem_t* scratch, int cols, bool ascending, int num_threads);
+
+
+/**
+ * Merges consecutive sorted runs of a row into a single sorted row, as rounds of pairwise
+ * merges with each merge split evenly across the threads.
+ * Uses the same scratch buffer as `parallel_local_sort`.
+ *
+ * @param row          Array holding the runs back to back
+ * @param bounds       Run boundaries: run i is row[bounds[i], bounds[i + 1]) (overwritten)
+ * @param runs         Number of runs
+ * @param ascending    Order of the runs (and of the output)
+ * @param num_threads  Number of threads to use
+ */
+void parallel_merge_runs(elem_t* row, int* bounds, int runs, bool ascending, int num_threads);
+
+
+/**
+ * Same as `parallel_merge_runs`, through a caller-provided scratch buffer.
+ *
+ * @param row          Array holding the runs back to back
+ * @param scratch      Scratch buffer of at least `bounds[runs]` elements
+ * @param bounds       Run boundaries: run i is row[bounds[i], bounds[i + 1]) (overwritten)
+ * @param runs         Number of runs
+ * @param ascending    Order of the runs (and of the output)
+ * @param num_threads  Number of threads to use
+ */
+void parallel_merge_runs_buffered(elem_t* row, elem_t* scratch, int* bounds, int runs, bool ascending, int num_threads);
+
+
+/**
+ * Releases the scratch buffer kept by `parallel_local_sort` between calls.
+ */
+void parallel_sort_release(void);
+
+#endif
@@ -0,0 +1,46 @@
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include "sort_key.h"
+#include "arena.h"
+
+#define RADIX_BITS           8      // Bits per LSD digit (4 passes for 32-bit keys, 8 for 64-bit ones)
+#define RADIX_BUCKETS        (1 << RADIX_BITS)
+#define RADIX_SMALL_CUTOFF   64     // Rows shorter than this are insertion sorted
+
+
+/**
+ * Sorts a row with an LSD radix sort on the keys (payloads move with their key).
+ * The scratch buffer is owned by the module and reused across calls, it only grows
+ * when a larger row than any previous one is sorted.
+ *
+ * @param row        Array representing the row to be sorted
+ * @param cols       Number of elements in the row
+ * @param ascending  If true, sort in ascending order; if false, sort in descending order
+ */
+void radix_sort(elem_t* row, int cols, bool ascending);
+
+
+/**
+ * Same as `radix_sort`, but ping-pongs through a caller-provided scratch buffer.
+ * The sorted result always ends up in `row`.
+ *
+ * @param row        Array representing the row to be sorted
+ * @param scratch    Scratch buffer of at least `cols` elements
+ * @param cols       Number of elements in the row
+ * @param ascending  If true, sort in ascending order; if false, sort in descending order
+ */
+void radix_sort_buffered(elem_t* row, elem_t* scratch, int cols, bool ascending);
+
+
+/**
+ * Releases the scratch buffer kept by `radix_sort` between calls.
+ */
+void radix_sort_release(void);
+
+#endif
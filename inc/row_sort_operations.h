@@ -5,6 +5,13 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include "pairwise_kernels.h"
+#include "parallel_sort.h"
+#include "utils.h"
+
+#define ELBOW_BLOCK          2048       // Elements per cache-resident block of the elbow search
+#define HALF_CLEANER_PIECE   4096       // Pairs per task of the in-place half-cleaners
+#define HALF_CLEANER_SEGMENT (1 << 17)  // Elements of a segment that finishes its half-cleaners and merges while in cache
 
 
 /**
@@ -15,7 +22,19 @@
  * @param cols       Number of elements in each row
  * @param ascending  If true, ensure row1[i] <= row2[i]; if false, ensure row1[i] >= row2[i]
  */
-void pairwise_sort(int* row1, int* row2, int cols, bool ascending);
+void pairwise_sort(elem_t* row1, elem_t* row2, int cols, bool ascending);
+
+
+/**
+ * Performs the pairwise comparison of `pairwise_sort`, but only keeps the `row1` side of every
+ * pair, written over `row2`. `row1` is only read, so it may still be in use by a pending send.
+ *
+ * @param row1       Own row (read only)
+ * @param row2       Partner's row, overwritten with the kept elements
+ * @param cols       Number of elements in each row
+ * @param ascending  If true, keep the element-wise minimum; if false, the maximum
+ */
+void pairwise_keep(const elem_t* row1, elem_t* row2, int cols, bool ascending);
 
 
 /**
@@ -27,17 +46,112 @@ void pairwise_sort(int* row1, int* row2, int cols, bool ascending);
  * 
  * @return              Index of the min/max element
  */
-int find_elbow_element(const int* arr, int len_arr, bool find_min);
+int find_elbow_element(const elem_t* arr, int len_arr, bool find_min);
 
 
 /**
- * Performs sorting within a single row using the elbow pattern
- * 
+ * Performs pairwise comparison and swap between two rows (as `pairwise_sort`) and finds the
+ * elbow of `row1` in the same pass, block by block while the data is still in cache.
+ *
+ * @param row1          First row for comparison
+ * @param row2          Second row for comparison
+ * @param cols          Number of elements in each row
+ * @param ascending     If true, ensure row1[i] <= row2[i]; if false, ensure row1[i] >= row2[i]
+ * @param find_min      If true, find the minimum of row1; if false, find the maximum
+ * @param opposite_idx  If not NULL, receives the index of the (first) opposite extreme of row1
+ *
+ * @return              Index of the (first) min/max element of row1 after the exchange
+ */
+int pairwise_sort_elbow(elem_t* row1, elem_t* row2, int cols, bool ascending, bool find_min, int* opposite_idx);
+
+
+/**
+ * Performs `pairwise_keep` and finds the elbow of the kept elements (in `row2`) in the same pass.
+ *
+ * @param row1          Own row (read only)
+ * @param row2          Partner's row, overwritten with the kept elements
+ * @param cols          Number of elements in each row
+ * @param ascending     If true, keep the element-wise minimum; if false, the maximum
+ * @param find_min      If true, find the minimum of the kept elements; if false, the maximum
+ * @param opposite_idx  If not NULL, receives the index of the (first) opposite extreme
+ *
+ * @return              Index of the (first) min/max kept element
+ */
+int pairwise_keep_elbow(const elem_t* row1, elem_t* row2, int cols, bool ascending, bool find_min, int* opposite_idx);
+
+
+/**
+ * Merges the two monotone runs of a (cyclic) bitonic row, starting from its elbow,
+ * into a separate output buffer. The merge loop has no data-dependent branches.
+ *
+ * @param src        Bitonic row
+ * @param dst        Output buffer of `cols` elements (must not overlap `src`)
+ * @param cols       Number of elements in the row
+ * @param elbow      Index of the min (ascending) or max (descending) element of `src`
+ * @param ascending  If true, sort in ascending order; if false, sort in descending order
+ */
+void elbow_merge(const elem_t* src, elem_t* dst, int cols, int elbow, bool ascending);
+
+
+/**
+ * Same as `elbow_merge`, with the output split evenly across threads through merge path
+ * partitioning of the two runs.
+ *
+ * @param src          Bitonic row
+ * @param dst          Output buffer of `cols` elements (must not overlap `src`)
+ * @param cols         Number of elements in the row
+ * @param elbow        Index of the min (ascending) or max (descending) element of `src`
+ * @param opposite     Index of the max (ascending) or min (descending) element of `src`
+ * @param ascending    If true, sort in ascending order; if false, sort in descending order
+ * @param num_threads  Number of threads to use
+ */
+void elbow_merge_parallel(const elem_t* src, elem_t* dst, int cols, int elbow, int opposite, bool ascending, int num_threads);
+
+
+/**
+ * Performs sorting within a single row using the elbow pattern.
+ * Uses a scratch buffer kept between calls, so no allocation happens per stage.
+ *
  * @param row        Array representing the row to be sorted
  * @param cols       Number of elements in the row
  * @param ascending  If true, sort in ascending order; if false, sort in descending order
  */
-void elbow_sort(int* row, int cols, bool ascending);
+void elbow_sort(elem_t* row, int cols, bool ascending);
+
+
+/**
+ * Releases the scratch buffer kept by `elbow_sort` between calls.
+ */
+void elbow_sort_release(void);
+
+
+/**
+ * Sorts a (cyclic) bitonic row in place with bounded scratch. Half-cleaners (`pairwise_sort` of the
+ * two halves of every segment) split the row down to segments of `block` elements: each segment is
+ * then bitonic and lies between its neighbors, and is merged around its elbow through a scratch
+ * buffer of `block` elements per thread. Once the segments fit in cache (HALF_CLEANER_SEGMENT),
+ * each one runs its remaining half-cleaners and merges at once instead of one pass per level.
+ *
+ * @param row          Bitonic row
+ * @param cols         Number of elements in the row (a power of two)
+ * @param block        Elements merged through scratch at once (a power of two)
+ * @param ascending    If true, sort in ascending order; if false, sort in descending order
+ * @param num_threads  Number of threads to use
+ */
+void bitonic_merge_bounded(elem_t* row, int cols, int block, bool ascending, int num_threads);
+
+
+/**
+ * Sorts a row in place with bounded scratch: its blocks are sorted in alternating directions
+ * (`local_sort`), then pairs, quadruples, ... of them are merged by `bitonic_merge_bounded`.
+ *
+ * @param row          Array representing the row to be sorted
+ * @param cols         Number of elements in the row (a power of two)
+ * @param block        Elements sorted at once (a power of two)
+ * @param ascending    If true, sort in ascending order; if false, sort in descending order
+ * @param num_threads  Number of threads to use
+ */
+void bitonic_sort_bounded(elem_t* row, int cols, int block, bool ascending, int num_threads);
 
 
 #endif
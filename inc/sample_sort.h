@@ -0,0 +1,36 @@
+#ifndef SAMPLE_SORT_H
+#define SAMPLE_SORT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <limits.h>
+#include <stddef.h>
+#include <mpi.h>
+#include "config.h"
+#include "arena.h"
+#include "utils.h"
+#include "parallel_sort.h"
+#include "trace.h"
+
+
+/**
+ * Distributed sample sort (regular sampling) with the same interface as `bitonic_sort_any`.
+ * Every row is sorted locally, `rows - 1` regularly spaced samples per row select the splitters,
+ * a single `MPI_Alltoallv` sends every element to its bucket and the received runs are merged.
+ * Ties are broken by (rank, position), so duplicate keys spread over the buckets too.
+ * A final exchange moves the (few) elements needed to restore the layout of `bitonic_sort_any`.
+ *
+ * On return the data is sorted across the processes in rank order: every row is full except
+ * the last non-empty one, and the rows after it are empty.
+ *
+ * @param local_row  Array of `capacity` elements, the first `*count` of which hold the local data
+ * @param count      Number of elements of the current process (updated)
+ * @param capacity   Number of elements every row can hold (at least the largest initial count)
+ * @param presorted  The local data is already sorted in ascending order (skips the local sort)
+ * @param comm       Communicator of the sort: one row per process, sorted in rank order
+ */
+void sample_sort(elem_t* local_row, int* count, int capacity, bool presorted, MPI_Comm comm);
+
+#endif
@@ -0,0 +1,86 @@
+#ifndef SHM_EXCHANGE_H
+#define SHM_EXCHANGE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <mpi.h>
+#include "row_sort_operations.h"
+#include "trace.h"
+
+
+/**
+ * Node-local shared memory used for zero-copy exchanges between partners on the same node.
+ * Every process owns a segment of two rows (the data row and the spare row of `bitonic_sort`)
+ * inside an `MPI_Win_allocate_shared` window, which its node neighbors can access directly.
+ * The window is only allocated with `--shm on` and on the nodes where some process has a partner of
+ * the whole-row schedule (rank ^ 2^step), elsewhere `rows` stays NULL and every exchange sends
+ * messages. The map of the node is built either way.
+ */
+typedef struct {
+    MPI_Comm node_comm;     // Processes sharing this node
+    MPI_Win  win;           // Shared window of the node
+    elem_t*  rows;          // Own segment: rows[0, cols) and rows[cols, 2 * cols), NULL without a window
+    int      cols;          // Number of elements in each row
+    int*     node_rank;     // Node rank of every process of `comm`, -1 for processes on other nodes
+} shm_context_t;
+
+
+/**
+ * Maps the processes of the node and creates its shared window, if asked for and if any process
+ * of the node has a partner on it (collective over `comm`).
+ *
+ * @param ctx          Context to initialize
+ * @param cols         Number of elements in each row
+ * @param with_window  Allocate the window (`--shm`)
+ * @param comm         Communicator of the sort
+ */
+void shm_context_create(shm_context_t* ctx, int cols, bool with_window, MPI_Comm comm);
+
+
+/**
+ * Frees the shared window (collective over `comm`).
+ *
+ * @param ctx   Context to free
+ */
+void shm_context_free(shm_context_t* ctx);
+
+
+/**
+ * Checks whether a process shares this node and the window (false for every partner without a window).
+ *
+ * @param ctx      Shared memory context
+ * @param partner  Rank of the process in the communicator of the sort
+ */
+bool shm_is_local(const shm_context_t* ctx, int partner);
+
+
+/**
+ * Checks whether a process shares this node, with or without a window.
+ *
+ * @param ctx      Shared memory context
+ * @param partner  Rank of the process in the communicator of the sort
+ */
+bool shm_same_node(const shm_context_t* ctx, int partner);
+
+
+/**
+ * Compare-exchange performed directly on the partner's row, without any message copy.
+ * Each of the two processes handles one half of the columns for both rows; they synchronize
+ * (zero-byte messages and window syncs) before and after the exchange.
+ *
+ * @param ctx          Shared memory context
+ * @param row_index    Which of the two rows of the own segment holds the data (0 or 1, the
+ *                     partner's one is traded in the opening synchronization)
+ * @param rank         Rank of the current process
+ * @param partner      Rank of the partner (must be local)
+ * @param ascending    Direction of the lower rank: if true it keeps the minimum of each pair
+ * @param num_threads  Number of threads to use
+ * @param tag          Message tag of this exchange
+ * @param comm         Communicator of the sort
+ */
+void shm_pairwise_exchange(shm_context_t* ctx, int row_index, int rank, int partner, bool ascending,
+                           int num_threads, int tag, MPI_Comm comm);
+
+#endif
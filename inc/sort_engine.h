@@ -0,0 +1,68 @@
+#ifndef SORT_ENGINE_H
+#define SORT_ENGINE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <float.h>
+#include <mpi.h>
+#include "config.h"
+#include "parallel_sort.h"
+#include "bitonic_sort.h"
+#include "sample_sort.h"
+
+#define PROBE_BYTES    (1 << 20)    // Message size of the bandwidth probe
+#define MERGE_PROBE    (1 << 15)    // Elements per run of the merge speed probe
+
+
+// Measured machine parameters of the cost model
+typedef struct {
+    double latency;         // Seconds per message (slowest process)
+    double bandwidth;       // Bytes per second of a pairwise exchange (slowest link)
+    double merge_time;      // Seconds per merged element (slowest process)
+} link_model_t;
+
+
+/**
+ * Measures the machine parameters of the cost model: the pairwise exchanges probe the
+ * farthest partner of the bitonic schedule (rank ^ 2^(stages - 1)), which is the slowest
+ * link once the ranks follow the node/socket hierarchy.
+ *
+ * @param comm  Communicator of the sort
+ *
+ * @return      The parameters, identical on every process
+ */
+link_model_t sort_engine_calibrate(MPI_Comm comm);
+
+
+/**
+ * Estimates the time of both engines and returns the faster one.
+ * Bitonic: stages * (stages + 1) / 2 whole-row exchanges, a compare-exchange per step and an
+ * elbow merge per stage. Sample sort: one all-to-all of the rows (and its `rows - 1` messages
+ * per process) followed by a log2(rows) pass merge of the received runs.
+ *
+ * @param model     Machine parameters
+ * @param rows      Number of processes
+ * @param capacity  Elements per row
+ * @param bitonic   Estimated seconds of the bitonic sort (output, may be NULL)
+ * @param sample    Estimated seconds of the sample sort (output, may be NULL)
+ *
+ * @return          ENGINE_BITONIC or ENGINE_SAMPLE
+ */
+sort_engine_t sort_engine_select(const link_model_t* model, int rows, int capacity, double* bitonic, double* sample);
+
+
+/**
+ * Sorts with the engine of `sort_config.engine` (calibrating and applying the cost model for
+ * ENGINE_AUTO). Same interface and result layout as `bitonic_sort_any`.
+ *
+ * @param local_row  Array of `capacity` elements, the first `*count` of which hold the local data
+ * @param count      Number of elements of the current process (updated)
+ * @param capacity   Number of elements every row can hold (at least the largest initial count)
+ * @param presorted  The local data is already sorted in ascending order (skips the local sort)
+ * @param comm       Communicator of the sort: one row per process, sorted in rank order
+ */
+void sort_engine_run(elem_t* local_row, int* count, int capacity, bool presorted, MPI_Comm comm);
+
+#endif
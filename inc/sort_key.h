@@ -0,0 +1,114 @@
+#ifndef SORT_KEY_H
+#define SORT_KEY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <float.h>
+#include <mpi.h>
+
+// Element type of the build, picked at compile time (`make KEY=... PAYLOAD=...`) so that every
+// kernel, exchange and MPI datatype is specialized for it:
+//   SORT_KEY_INT32 (default) | SORT_KEY_INT64 | SORT_KEY_FLOAT
+//   SORT_PAYLOAD 0: bare keys | 1: (key, record id) pairs, the id moves with its key
+#ifndef SORT_PAYLOAD
+#define SORT_PAYLOAD 0
+#endif
+
+#if defined(SORT_KEY_INT64)
+    typedef int64_t  sort_key_t;
+    typedef uint64_t sort_id_t;         // Same width as the key: no padding in the pairs
+    typedef uint64_t key_bits_t;
+    #define KEY_NAME        "int64"
+    #define KEY_MPI_TYPE    MPI_INT64_T
+    #define KEY_FORMAT      "%" PRId64
+#elif defined(SORT_KEY_FLOAT)
+    typedef float    sort_key_t;
+    typedef uint32_t sort_id_t;
+    typedef uint32_t key_bits_t;
+    #define KEY_NAME        "float"
+    #define KEY_MPI_TYPE    MPI_FLOAT
+    #define KEY_FORMAT      "%g"
+#else
+    #ifndef SORT_KEY_INT32
+    #define SORT_KEY_INT32
+    #endif
+    typedef int32_t  sort_key_t;
+    typedef uint32_t sort_id_t;
+    typedef uint32_t key_bits_t;
+    #define KEY_NAME        "int32"
+    #define KEY_MPI_TYPE    MPI_INT
+    #define KEY_FORMAT      "%d"
+#endif
+
+#define KEY_BITS  (int)(8 * sizeof(sort_key_t))
+
+
+#if SORT_PAYLOAD
+    // Key and record id, the pair moves as a whole
+    typedef struct {
+        sort_key_t key;
+        sort_id_t  id;
+    } elem_t;
+
+    #define KEY(e)          ((e).key)
+    #define ELEM_NAME       KEY_NAME "+id"
+#else
+    typedef sort_key_t elem_t;
+
+    #define KEY(e)          (e)
+    #define ELEM_NAME       KEY_NAME
+#endif
+
+
+/**
+ * Maps a key to unsigned bits whose unsigned order is the ascending key order:
+ * flipping the sign bit of an integer orders the negatives first, a float also has every
+ * other bit of its negatives flipped so that larger magnitudes come first.
+ * XOR-ing the result with all ones gives the descending order.
+ *
+ * @param key  Key to be mapped
+ */
+static inline key_bits_t key_to_bits(sort_key_t key) {
+    const key_bits_t sign = (key_bits_t)1 << (KEY_BITS - 1);
+#if defined(SORT_KEY_FLOAT)
+    key_bits_t bits;
+    __builtin_memcpy(&bits, &key, sizeof(bits));
+    return (bits & sign) ? ~bits : (bits | sign);
+#else
+    return (key_bits_t)key ^ sign;
+#endif
+}
+
+
+/**
+ * Inverse of `key_to_bits`.
+ *
+ * @param bits  Unsigned bits of a key
+ */
+static inline sort_key_t bits_to_key(key_bits_t bits) {
+    const key_bits_t sign = (key_bits_t)1 << (KEY_BITS - 1);
+#if defined(SORT_KEY_FLOAT)
+    bits = (bits & sign) ? (bits ^ sign) : ~bits;
+    sort_key_t key;
+    __builtin_memcpy(&key, &bits, sizeof(key));
+    return key;
+#else
+    return (sort_key_t)(bits ^ sign);
+#endif
+}
+
+
+/**
+ * MPI datatype matching `elem_t`: the key type itself, MPI_2INT / MPI_FLOAT_INT for the
+ * 32-bit pairs and a committed contiguous pair of MPI_INT64_T for the 64-bit ones.
+ */
+MPI_Datatype elem_mpi_type(void);
+
+
+/**
+ * Releases the datatype committed by `elem_mpi_type` (call before `MPI_Finalize`).
+ */
+void elem_mpi_type_release(void);
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef STREAM_EXCHANGE_H
+#define STREAM_EXCHANGE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <mpi.h>
+#include "config.h"
+#include "row_sort_operations.h"
+#include "trace.h"
+
+#define STREAM_RING         4               // Staging buffers in flight per exchange
+#define STREAM_BLOCK_BYTES  (256 << 10)     // Default block size of the streaming exchange (`--chunk auto`)
+#define STREAM_SORT_BYTES   (4 << 20)       // Blocks sorted at once by the initial in-place sort
+
+
+/**
+ * Bounded-memory whole-row exchange (`--exchange stream`).
+ * The partner's row never lands in a full-size buffer: its blocks arrive in a ring of `STREAM_RING`
+ * staging buffers, and every one is compare-exchanged in place into the own row as soon as the own
+ * block it displaces has left. Up to `STREAM_RING` blocks are in flight in each direction.
+ */
+typedef struct {
+    elem_t*     ring;                   // STREAM_RING staging buffers of `block` elements
+    int         block;                  // Elements per block
+    MPI_Request sends[STREAM_RING];     // Send of the own block of every slot
+    MPI_Request recvs[STREAM_RING];     // Receive of the partner's block into every slot
+} stream_exchange_t;
+
+
+/**
+ * Returns the block size of the streaming exchange for rows of `cols` elements: `--chunk` (or
+ * STREAM_BLOCK_BYTES) rounded down to a power of two of elements, at most `cols`.
+ *
+ * @param cols  Number of elements in each row (a power of two)
+ */
+int stream_exchange_block(int cols);
+
+
+/**
+ * Returns the base case of the initial in-place sort: STREAM_SORT_BYTES (at least `block`) rounded down
+ * to a power of two of elements, at most `cols`. Fewer, larger blocks mean fewer merge levels.
+ *
+ * @param cols   Number of elements in each row (a power of two)
+ * @param block  Block size of the exchange
+ */
+int stream_sort_block(int cols, int block);
+
+
+/**
+ * Takes the ring of staging buffers from the arena (`ARENA_RING`, mapped by the first sort).
+ *
+ * @param ex     Engine to initialize
+ * @param block  Elements per block
+ */
+void stream_exchange_init(stream_exchange_t* ex, int block);
+
+
+/**
+ * Compare-exchanges `row` with the partner's row block by block, in place: on return `row`
+ * holds the element-wise minimum (`keep_min`) or maximum of the two rows.
+ *
+ * @param ex           Engine
+ * @param row          Own row, sent to the partner and overwritten with the kept elements
+ * @param cols         Number of elements in each row
+ * @param partner      Rank of the partner
+ * @param tag          Tag of the exchange
+ * @param keep_min     If true keep the element-wise minimum, the maximum otherwise
+ * @param num_threads  Threads compare-exchanging every block
+ * @param comm         Communicator of the sort
+ */
+void stream_exchange_run(stream_exchange_t* ex, elem_t* row, int cols, int partner, int tag, bool keep_min,
+                         int num_threads, MPI_Comm comm);
+
+
+/**
+ * Detaches the ring, which the arena keeps for the next sorts.
+ *
+ * @param ex  Engine to free
+ */
+void stream_exchange_free(stream_exchange_t* ex);
+
+#endif
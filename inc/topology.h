@@ -0,0 +1,45 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <mpi.h>
+
+
+// Position of a process in the node/socket hierarchy
+typedef struct {
+    int node;       // Lowest rank (in the parent communicator) running on the same node
+    int socket;     // Physical package the process runs on (0 if unknown)
+    int rank;       // Rank in the parent communicator
+} topology_slot_t;
+
+
+/**
+ * Builds a communicator with the same processes as `comm`, renumbered so that the
+ * frequent exchange partners share the fastest links.
+ * The bitonic schedule pairs rank r with r ^ 2^step, and low steps run in almost every
+ * stage, so the new ranks are assigned node by node and, inside each node, socket by
+ * socket: partners that differ in the low bits then stay on the same socket/node.
+ * Processes on the same socket keep their relative order.
+ *
+ * @param comm  Parent communicator
+ *
+ * @return      The reordered communicator (to be released with `MPI_Comm_free`)
+ */
+MPI_Comm topology_comm_create(MPI_Comm comm);
+
+
+/**
+ * Prints (on rank 0 of `sort_comm`) how the bytes of the exchange schedule split between
+ * intra-socket, inter-socket and inter-node links, for the original order of `MPI_COMM_WORLD`
+ * and for the order of `sort_comm`.
+ * The volumes assume whole-row exchanges, so they are an upper bound for `--exchange split`.
+ *
+ * @param sort_comm  Communicator the sort runs on (same processes as `MPI_COMM_WORLD`)
+ * @param row_bytes  Bytes of a row
+ */
+void topology_report(MPI_Comm sort_comm, long long row_bytes);
+
+#endif
@@ -0,0 +1,122 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <mpi.h>
+#include "config.h"
+
+#define TRACE_COUNTERS  3   // Hardware counters of every event: cycles, instructions, cache misses
+
+
+// Phase recorded by an event
+typedef enum {
+    TRACE_CALIBRATE,        // Cost model and chunk size probes
+    TRACE_LOCAL_SORT,       // Initial sort of the row
+    TRACE_EXCHANGE,         // Chunked whole-row exchange with a partner
+    TRACE_SHM_EXCHANGE,     // In-place compare-exchange through the node's shared window
+    TRACE_COMPARE_SPLIT,    // Compare-split with a partner
+    TRACE_MERGE,            // Elbow merge at the end of a stage, or merge of the received runs
+    TRACE_SPLITTERS,        // Sample sort: sampling and splitter selection
+    TRACE_ALLTOALL,         // Sample sort: bucket exchange, or the final rebalance
+    TRACE_NUM_KINDS
+} trace_kind_t;
+
+
+// One phase of one process
+typedef struct {
+    int          kind;                          // trace_kind_t
+    int          stage, step;                   // Position in the network (-1 outside of it)
+    int          partner;                       // Partner of the exchange (-1 for collectives and local work)
+    double       start;                         // Seconds since the common start of the trace
+    double       duration;                      // Seconds of the whole phase
+    double       wait;                          // Seconds spent blocked in communication or synchronization
+    long long    bytes_sent, bytes_received;
+    long long    counters[TRACE_COUNTERS];      // Hardware counter deltas (-1 if unavailable)
+} trace_event_t;
+
+
+/**
+ * Opens the hardware counters if `--trace` and `--trace-counters` ask for them. Must run before
+ * the first OpenMP parallel region: the counters are inherited by the threads started after
+ * them, so the events count the work of the whole process, not only of the thread driving it.
+ */
+void trace_counters_open(void);
+
+
+/**
+ * Starts the trace if `sort_config.trace_prefix` is set (collective over `comm`): the time origin
+ * is taken right after a barrier, and the hardware counters are opened if requested.
+ *
+ * @param comm  Communicator of the sort
+ */
+void trace_init(MPI_Comm comm);
+
+
+/**
+ * Checks whether events are being recorded.
+ */
+bool trace_enabled(void);
+
+
+/**
+ * Opens an event (the previous one must be closed). No-op when tracing is off.
+ *
+ * @param kind     Phase
+ * @param stage    Stage of the network, or -1
+ * @param step     Step of the stage, or -1
+ * @param partner  Partner process, or -1
+ */
+void trace_begin(trace_kind_t kind, int stage, int step, int partner);
+
+
+/**
+ * Marks the start of a blocking call inside the open event.
+ */
+void trace_wait_begin(void);
+
+
+/**
+ * Marks the end of a blocking call: its time counts as wait instead of compute.
+ */
+void trace_wait_end(void);
+
+
+/**
+ * Adds transferred bytes to the open event (and to the process totals of `trace_traffic`,
+ * which are kept even when tracing is off).
+ *
+ * @param sent      Bytes sent
+ * @param received  Bytes received
+ */
+void trace_bytes(long long sent, long long received);
+
+
+/**
+ * Closes the open event.
+ */
+void trace_end(void);
+
+
+/**
+ * Returns the message bytes of this process since the previous call (shared memory exchanges
+ * move no messages) and resets the totals.
+ *
+ * @param sent      Bytes sent (output)
+ * @param received  Bytes received (output)
+ */
+void trace_traffic(long long* sent, long long* received);
+
+
+/**
+ * Gathers every event to rank 0, which writes `<prefix>.csv` (one row per event), `<prefix>.json`
+ * (per-process totals and the events) and `<prefix>.trace.json` (Chrome trace timeline, one row per
+ * process) and prints the slowest process and the longest wait (collective over `comm`).
+ *
+ * @param comm  Communicator of the sort
+ */
+void trace_finalize(MPI_Comm comm);
+
+#endif
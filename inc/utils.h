@@ -7,20 +7,25 @@
 #include <math.h>
 #include <string.h>
 #include <mpi.h>
+#include "config.h"
+#include "sort_key.h"
+#include "radix_sort.h"
+#include "parallel_sort.h"
 
 // Version 0: serial qsort
-// Version 1: multithreaded sorting
-#define SORT_VERSION 0
+// Version 1: multithreaded sorting (`--threads` radix sorted slices, merged in parallel)
+// Version 2: serial LSD radix sort (on the key bits, see `sort_key.h`)
+#define SORT_VERSION 1
 
 
 /**
- * Sorts a single row either in ascending or descending order using qsort
+ * Sorts a single row either in ascending or descending order using the `SORT_VERSION` backend
  * 
  * @param row        Array representing the row to be sorted
  * @param cols       Number of elements in the row
  * @param ascending  If true, sort in ascending order; if false, sort in descending order
  */
-void local_sort(int* row, int cols, bool ascending);
+void local_sort(elem_t* row, int cols, bool ascending);
 
 
 /**
@@ -31,7 +36,7 @@ void local_sort(int* row, int cols, bool ascending);
  * @param cols       Number of columns in each row
  * @param rank       Rank of the current process
  */
-void initial_alternating_sort(int* row, int cols, int rank);
+void initial_alternating_sort(elem_t* row, int cols, int rank);
 
 
 /**
@@ -43,6 +48,6 @@ void initial_alternating_sort(int* row, int cols, int rank);
  * @param size   Total number of rows/processes
  * 
  */
-void print_row(int* row, int cols, int rank, int size) ;
+void print_row(elem_t* row, int cols, int rank, int size) ;
 
 #endif
\ No newline at end of file
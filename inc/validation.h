@@ -3,7 +3,12 @@
 
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <string.h>
 #include <mpi.h>
+#include "config.h"
+#include "sort_key.h"
+#include "generator.h"
 
 
 /**
@@ -17,20 +22,108 @@
  * @return              true if the array is sorted in ascending or descending order,
  *                      false otherwise.
  */
-bool is_localy_sorted(int* row, int cols, bool* is_ascending);
+bool is_localy_sorted(elem_t* row, int cols, bool* is_ascending);
 
 
 /**
- * Validates the correctness of the distributed bitonic sort.
- * Each process checks if its local row is sorted and if the global order is maintained.
+ * Order-independent fingerprint of a multiset of elements: any permutation of the same elements
+ * gives the same one, while a dropped, duplicated or altered element changes it (up to hash collisions).
+ * Every element is hashed (splitmix64 of its key bits, and of its id with a payload) and the hashes
+ * are combined by sums and a xor, which do not depend on where the elements are.
+ */
+typedef struct {
+    uint64_t count;     // Number of elements
+    uint64_t sum;       // Sum of the element hashes (mod 2^64)
+    uint64_t sum2;      // Sum of a second hash of every element
+    uint64_t xored;     // Xor of the element hashes
+    uint64_t disorder;  // Order violations found by `validate_sort` (0 in a fingerprint of the input)
+} fingerprint_t;
+
+
+/**
+ * Adds local elements to a fingerprint (no communication), in one vectorized pass over them.
+ * A row can be added piece by piece: the result does not depend on the pieces.
+ *
+ * @param fp     Fingerprint to update
+ * @param row    Elements to add
+ * @param count  Number of elements
+ */
+void fingerprint_add(fingerprint_t* fp, const elem_t* row, int count);
+
+
+/**
+ * Combines the local fingerprints of all the processes (collective over `comm`, a single `MPI_Allreduce`).
+ *
+ * @param fp    Local fingerprint, replaced by the global one
+ * @param comm  Communicator of the sort
+ */
+void fingerprint_reduce(fingerprint_t* fp, MPI_Comm comm);
+
+
+/**
+ * Returns true if two fingerprints describe the same multiset (`disorder` is ignored).
+ *
+ * @param a  First fingerprint
+ * @param b  Second fingerprint
+ */
+bool fingerprint_equal(const fingerprint_t* a, const fingerprint_t* b);
+
+
+/**
+ * Computes the fingerprint of the elements of all the processes (collective over `comm`):
+ * `fingerprint_add` of the local row, then `fingerprint_reduce`.
+ *
+ * @param row    Local row
+ * @param count  Number of elements of this process
+ * @param comm   Communicator of the sort
+ *
+ * @return       Fingerprint of the whole input, on every process
+ */
+fingerprint_t fingerprint_rows(const elem_t* row, int count, MPI_Comm comm);
+
+
+/**
+ * Validates a distributed sort (collective over `comm`): the rows must be sorted in rank order,
+ * filled in rank order (no empty row before a non-empty one, as both engines leave them), and hold
+ * a permutation of the input. Every process scans its row once (vectorized order check and
+ * fingerprint) while its last key travels to the next rank in a single nonblocking neighbor
+ * exchange; a single `MPI_Allreduce` then combines the fingerprints and the violations.
+ * Failures are reported on stderr.
+ *
+ * @param row     Local row after the sort
+ * @param count   Number of elements of this process (may be 0 for the trailing rows)
+ * @param before  Fingerprint of the input (`fingerprint_rows` before the sort)
+ * @param comm    Communicator the rows were sorted on (rows are ordered by rank in it)
+ *
+ * @return        true on every process if the sort is correct
+ */
+bool validate_sort(const elem_t* row, int count, const fingerprint_t* before, MPI_Comm comm);
+
+/**
+ * Same as `validate_sort` for a row the caller scanned itself, e.g. streamed block by block from disk:
+ * `after` holds the fingerprint of the local row (`fingerprint_add`) and its number of descents
+ * (`count_descents` of every block, plus the descents between blocks) in `disorder`.
+ *
+ * @param first   First key of the local row (ignored if `count` is 0)
+ * @param last    Last key of the local row (ignored if `count` is 0)
+ * @param count   Number of elements of this process
+ * @param after   Local fingerprint of the result, replaced by the global one
+ * @param before  Fingerprint of the input
+ * @param comm    Communicator the rows were sorted on
+ *
+ * @return        true on every process if the sort is correct
+ */
+bool validate_scanned(sort_key_t first, sort_key_t last, int count, fingerprint_t* after, const fingerprint_t* before, MPI_Comm comm);
+
+
+/**
+ * Counts the descents of a row (positions where a key is smaller than the previous one), vectorized.
+ *
+ * @param row    Row to check
+ * @param count  Number of elements
  *
- * @param local_row  Pointer to the local row (array of integers).
- * @param cols       Number of columns in each row.
- * @param rank       The rank of the process.
- * @param size       Total number of processes.
- * @param eval       true if this row is sorted with the previous one,
- *                   false otherwise.
+ * @return       0 if the row is sorted in ascending order
  */
-void validate_bitonic_sort(int* local_row, int cols, int rank, int size, bool* eval);
+uint64_t count_descents(const elem_t* row, int count);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,73 @@
+#ifndef WIRE_CODEC_H
+#define WIRE_CODEC_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <mpi.h>
+#include "sort_key.h"
+
+#define WIRE_LANES        8                             // Interleaved lanes of the bit-packing (one vector of 32-bit lanes)
+#define WIRE_BLOCK        (WIRE_LANES * KEY_BITS)       // Keys per packed block: each lane holds KEY_BITS deltas of `width` bits
+#define WIRE_MIN_SAVING   0.1                           // Smallest fraction of the bytes compression must save to be switched on
+#define WIRE_PROBE        (1 << 16)                     // Keys of the codec speed probe
+#define WIRE_REPEATS      4                             // Probes of the codec speed (the fastest one is kept)
+
+
+/**
+ * Wire format of the compressed whole-row exchanges (`--compress`).
+ * A chunk of a bitonic row moves in small steps, so it is sent as the zigzag-encoded differences of
+ * its consecutive keys (in the unsigned order of `key_to_bits`), bit-packed per block of WIRE_BLOCK
+ * keys at the width of the largest difference of the block. The packing interleaves WIRE_LANES lanes,
+ * so that every shift and mask of a block runs on whole vectors.
+ * A chunk that does not shrink enough travels raw behind the same header. Bare keys only: the ids of a
+ * payload build are random and travel raw.
+ */
+typedef struct {
+    int32_t    count;       // Elements of the chunk
+    int32_t    packed;      // 1: bit-packed keys, 0: raw elements
+    key_bits_t base;        // Bits of the first key (packed)
+} wire_header_t;
+
+
+/**
+ * Largest encoded size of a chunk of `count` elements, in bytes.
+ *
+ * @param count  Elements of the chunk
+ */
+size_t wire_bound(int count);
+
+
+/**
+ * Encodes a chunk. It is bit-packed if that takes at most `max_ratio` of its raw size, copied raw otherwise.
+ *
+ * @param chunk      Elements to encode
+ * @param count      Number of them
+ * @param max_ratio  Largest encoded / raw size worth packing (0: always raw)
+ * @param out        Buffer of at least `wire_bound(count)` bytes
+ *
+ * @return           Encoded size in bytes
+ */
+size_t wire_encode(const elem_t* chunk, int count, double max_ratio, void* out);
+
+
+/**
+ * Decodes a chunk of `wire_encode`.
+ *
+ * @param in     Encoded chunk
+ * @param chunk  Receives its elements
+ *
+ * @return       Number of elements decoded
+ */
+int wire_decode(const void* in, elem_t* chunk);
+
+
+/**
+ * Raw bytes per second that the codec encodes and then decodes, on a sorted probe of small gaps
+ * (the fastest of a few repeats).
+ */
+double wire_codec_speed(void);
+
+#endif
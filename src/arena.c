@@ -0,0 +1,117 @@
+#include "../inc/arena.h"
+
+#ifndef MAP_HUGETLB
+#define MAP_HUGETLB 0
+#endif
+
+// Buffers of the slots and their mapped sizes
+static void*  arena_slots[ARENA_NUM_SLOTS];
+static size_t arena_sizes[ARENA_NUM_SLOTS];
+
+// Explicit huge pages failed once: the pool is empty or missing, later mappings go straight to the fallback
+static bool explicit_failed = false;
+
+
+static size_t mapped_size(size_t bytes) {
+    if (bytes == 0) bytes = 1;
+    return (bytes + ARENA_ALIGN - 1) / ARENA_ALIGN * ARENA_ALIGN;
+}
+
+
+// Over-maps by one huge page and trims both ends, so the mapping starts on a 2 MiB boundary
+static char* map_aligned(size_t size) {
+    char* raw = mmap(NULL, size + ARENA_ALIGN, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED) return NULL;
+
+    char* aligned = (char*)(((uintptr_t)raw + ARENA_ALIGN - 1) & ~(uintptr_t)(ARENA_ALIGN - 1));
+    size_t head = (size_t)(aligned - raw);
+    if (head > 0) munmap(raw, head);
+    munmap(aligned + size, ARENA_ALIGN - head);
+    return aligned;
+}
+
+
+// Faults every page in from the thread that owns it in the static partition of the kernels
+static void first_touch(char* buffer, size_t size) {
+    long pages = (long)(size / ARENA_TOUCH_BYTES);
+
+    #pragma omp parallel for num_threads(sort_config.num_threads) schedule(static)
+    for (long page = 0; page < pages; page++) {
+        buffer[page * ARENA_TOUCH_BYTES] = 0;
+    }
+}
+
+
+void* arena_map(size_t bytes) {
+    size_t size = mapped_size(bytes);
+    char* buffer = NULL;
+
+    if (sort_config.hugepages == HUGEPAGES_EXPLICIT && MAP_HUGETLB && !explicit_failed) {
+        buffer = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (buffer == MAP_FAILED) {
+            buffer = NULL;
+            explicit_failed = true;
+            int initialized, rank = 0;
+            MPI_Initialized(&initialized);
+            if (initialized) MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+            if (rank == 0) {
+                printf("No explicit huge pages (see /proc/sys/vm/nr_hugepages): using transparent ones\n");
+            }
+        }
+    }
+
+    if (!buffer) {
+        buffer = map_aligned(size);
+        if (!buffer) return NULL;
+        // Only a hint: the kernel may still fall back to base pages
+        madvise(buffer, size, sort_config.hugepages == HUGEPAGES_OFF ? MADV_NOHUGEPAGE : MADV_HUGEPAGE);
+    }
+
+    first_touch(buffer, size);
+    return buffer;
+}
+
+
+void arena_unmap(void* buffer, size_t bytes) {
+    if (buffer) munmap(buffer, mapped_size(bytes));
+}
+
+
+void* arena_reserve(arena_slot_t slot, size_t bytes) {
+    if (arena_slots[slot] && bytes <= arena_sizes[slot]) return arena_slots[slot];
+
+    arena_release(slot);
+    arena_slots[slot] = arena_map(bytes);
+    if (!arena_slots[slot]) {
+        int initialized, rank = 0;
+        MPI_Initialized(&initialized);
+        if (initialized) MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+        fprintf(stderr, "Rank %d: Mapping %zu bytes failed\n", rank, bytes);
+        if (initialized) MPI_Abort(MPI_COMM_WORLD, -1);
+        exit(EXIT_FAILURE);
+    }
+    arena_sizes[slot] = mapped_size(bytes);
+    return arena_slots[slot];
+}
+
+
+void arena_release(arena_slot_t slot) {
+    arena_unmap(arena_slots[slot], arena_sizes[slot]);
+    arena_slots[slot] = NULL;
+    arena_sizes[slot] = 0;
+}
+
+
+void arena_release_all(void) {
+    for (int slot = 0; slot < ARENA_NUM_SLOTS; slot++) {
+        arena_release((arena_slot_t)slot);
+    }
+}
+
+
+void arena_page_faults(long long* minor, long long* major) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    *minor = usage.ru_minflt;
+    *major = usage.ru_majflt;
+}
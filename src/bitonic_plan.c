@@ -0,0 +1,317 @@
+#include "../inc/bitonic_plan.h"
+
+
+// Schedule of the whole-row exchange, as run by `bitonic_sort_rows`: every exchange and every merge
+// swaps the two buffers, so the buffer holding the row before each step is known in advance and the
+// persistent requests of the step can be bound to it
+static void plan_whole_row(bitonic_plan_t* plan) {
+    chunk_plan_t chunks;
+    trace_begin(TRACE_CALIBRATE, -1, -1, -1);
+    chunk_plan_create(&chunks, plan->cols, plan->num_threads, NULL, plan->comm);
+    trace_end();
+    chunk_plan_report(&chunks, plan->cols, plan->rank);
+
+    int source = 0;
+    for (int stage = 1; stage <= plan->stages; stage++) {
+        bool is_ascending = ((plan->rank >> stage) & 1) == 0;
+        for (int step = stage - 1; step >= 0; step--) {
+            bitonic_plan_step_t* s = &plan->steps[plan->num_steps++];
+            s->stage = stage;
+            s->step = step;
+            s->partner = bitonic_partner(plan->rank, stage, step, false);
+            s->keep_min = (plan->rank < s->partner) ? is_ascending : !is_ascending;
+            s->ascending = is_ascending;
+            s->chunk_elements = chunks.chunk_elements[step];
+            s->first_request = plan->num_requests;
+            s->source = source;
+            plan->num_requests += (plan->cols + s->chunk_elements - 1) / s->chunk_elements;
+            source ^= 1;
+        }
+        source ^= 1;  // The merge at the end of the stage
+    }
+
+    plan->sends = malloc((plan->num_requests > 0 ? plan->num_requests : 1) * sizeof(MPI_Request));
+    plan->recvs = malloc((plan->num_requests > 0 ? plan->num_requests : 1) * sizeof(MPI_Request));
+    if (!plan->sends || !plan->recvs) {
+        fprintf(stderr, "Rank %d: Memory allocation failed\n", plan->rank);
+        MPI_Abort(plan->comm, -1);
+    }
+    for (int i = 0; i < plan->num_steps; i++) {
+        const bitonic_plan_step_t* s = &plan->steps[i];
+        chunk_exchange_persistent_init(plan->sends + s->first_request, plan->recvs + s->first_request,
+                                       plan->buffers[s->source], plan->buffers[s->source ^ 1], plan->cols,
+                                       s->chunk_elements, s->partner, (s->stage << 8) | s->step, plan->comm);
+    }
+    chunk_exchange_init(&plan->exchange, plan->rank, plan->comm);
+}
+
+
+// Schedule of the compare-split exchange, as run by `bitonic_sort_split` (the "flip" network, without
+// the virtual partners). The messages depend on the data, so only the schedule and the buffer are kept
+static void plan_compare_split(bitonic_plan_t* plan) {
+    for (int stage = 1; stage <= plan->stages; stage++) {
+        for (int step = stage - 1; step >= 0; step--) {
+            int partner = bitonic_partner(plan->rank, stage, step, true);
+            if (partner == plan->rank || partner >= plan->rows) continue;
+
+            bitonic_plan_step_t* s = &plan->steps[plan->num_steps++];
+            memset(s, 0, sizeof(*s));
+            s->stage = stage;
+            s->step = step;
+            s->partner = partner;
+            s->keep_min = (plan->rank < partner);
+        }
+    }
+}
+
+
+void bitonic_plan_create(bitonic_plan_t* plan, elem_t* row, int cols, MPI_Comm comm) {
+    memset(plan, 0, sizeof(*plan));
+    MPI_Comm_dup(comm, &plan->comm);
+    MPI_Comm_rank(plan->comm, &plan->rank);
+    MPI_Comm_size(plan->comm, &plan->rows);
+    plan->cols = cols;
+    plan->num_threads = sort_config.num_threads;
+    while ((1 << plan->stages) < plan->rows) plan->stages++;
+
+    bool power_of_two = (plan->rows & (plan->rows - 1)) == 0;
+    plan->whole_row = power_of_two && sort_config.exchange_mode != EXCHANGE_SPLIT;
+    if (!plan->whole_row && sort_config.exchange_mode != EXCHANGE_SPLIT && plan->rank == 0)
+        printf("Plan: a non power of two number of processes: using the compare-split exchange\n");
+
+    plan->buffers[0] = row;
+    plan->buffers[1] = (elem_t*)arena_map((size_t)cols * sizeof(elem_t));
+    plan->steps = malloc((plan->stages * (plan->stages + 1) / 2 + 1) * sizeof(bitonic_plan_step_t));
+    if (!plan->buffers[1] || !plan->steps) {
+        fprintf(stderr, "Rank %d: Memory allocation failed\n", plan->rank);
+        MPI_Abort(plan->comm, -1);
+    }
+
+    if (plan->whole_row) {
+        plan_whole_row(plan);
+    } else {
+        plan_compare_split(plan);
+    }
+}
+
+
+void bitonic_plan_execute(bitonic_plan_t* plan) {
+    elem_t* row = plan->buffers[0];
+    int cols = plan->cols;
+    int num_threads = plan->num_threads;
+
+    if (!plan->whole_row) {
+        trace_begin(TRACE_LOCAL_SORT, -1, -1, -1);
+        local_sort(row, cols, true);
+        trace_end();
+
+        int count = cols;
+        for (int i = 0; i < plan->num_steps; i++) {
+            const bitonic_plan_step_t* s = &plan->steps[i];
+            trace_begin(TRACE_COMPARE_SPLIT, s->stage, s->step, s->partner);
+            compare_split(row, plan->buffers[1], cols, &count, s->partner, s->keep_min, (s->stage << 8) | s->step, plan->comm);
+            trace_end();
+        }
+        return;
+    }
+
+    trace_begin(TRACE_LOCAL_SORT, -1, -1, -1);
+    initial_alternating_sort(row, cols, plan->rank);
+    trace_end();
+
+    // The last step of every stage finds the elbow, then the stage ends with the merge back into
+    // the buffer that held the row before that step
+    int elbow = -1, opposite = -1, result = 0;
+    for (int i = 0; i < plan->num_steps; i++) {
+        const bitonic_plan_step_t* s = &plan->steps[i];
+        elem_t* source = plan->buffers[s->source];
+        elem_t* kept = plan->buffers[s->source ^ 1];
+        bool last = (s->step == 0);
+
+        trace_begin(TRACE_EXCHANGE, s->stage, s->step, s->partner);
+        chunk_exchange_start(&plan->exchange, plan->sends + s->first_request, plan->recvs + s->first_request, source, kept,
+                             cols, s->chunk_elements, s->keep_min, s->ascending, last ? &elbow : NULL,
+                             (last && num_threads > 1) ? &opposite : NULL, num_threads);
+        trace_end();
+        if (!last) continue;
+
+        trace_begin(TRACE_MERGE, s->stage, -1, -1);
+        chunk_exchange_complete(&plan->exchange);
+        if (num_threads > 1) {
+            elbow_merge_parallel(kept, source, cols, elbow, opposite, s->ascending, num_threads);
+        } else {
+            elbow_merge(kept, source, cols, elbow, s->ascending);
+        }
+        result = s->source;
+        trace_end();
+    }
+    chunk_exchange_complete(&plan->exchange);
+
+    if (result != 0) memcpy(row, plan->buffers[result], cols * sizeof(elem_t));
+}
+
+
+// Completes (or tests) the sends of the last exchange
+static bool sends_done(bitonic_plan_t* plan, bool blocking) {
+    if (!blocking) return chunk_exchange_test_sends(&plan->exchange);
+    chunk_exchange_complete(&plan->exchange);
+    return true;
+}
+
+
+// Runs the phases of the sort until one has to wait for a message (which `blocking` waits for).
+// Returns true once the sort is complete
+static bool advance(bitonic_request_t* request, bool blocking) {
+    bitonic_plan_t* plan = request->plan;
+    int cols = plan->cols;
+    int num_threads = plan->num_threads;
+
+    for (;;) {
+        const bitonic_plan_step_t* s = (request->step < plan->num_steps) ? &plan->steps[request->step] : NULL;
+        switch (request->phase) {
+        case ISORT_LOCAL_SORT:
+            trace_begin(TRACE_LOCAL_SORT, -1, -1, -1);
+            if (plan->whole_row) {
+                initial_alternating_sort(plan->buffers[0], cols, plan->rank);
+            } else {
+                local_sort(plan->buffers[0], cols, true);
+            }
+            trace_end();
+            request->phase = s ? ISORT_POST : ISORT_FINISH;
+            break;
+
+        case ISORT_POST:
+            if (!plan->whole_row) {
+                // The messages of a compare-split depend on the data: it runs as one piece
+                trace_begin(TRACE_COMPARE_SPLIT, s->stage, s->step, s->partner);
+                compare_split(plan->buffers[0], plan->buffers[1], cols, &request->count, s->partner, s->keep_min,
+                              (s->stage << 8) | s->step, plan->comm);
+                trace_end();
+                request->step++;
+                request->phase = (request->step < plan->num_steps) ? ISORT_POST : ISORT_FINISH;
+                break;
+            }
+            if (!sends_done(plan, blocking)) return false;
+            chunk_exchange_post(&plan->exchange, plan->sends + s->first_request, plan->recvs + s->first_request,
+                                plan->buffers[s->source], plan->buffers[s->source ^ 1], cols, s->chunk_elements,
+                                s->keep_min, s->ascending);
+            request->phase = ISORT_RECEIVE;
+            break;
+
+        case ISORT_RECEIVE: {
+            bool last = (s->step == 0);
+            if (!chunk_exchange_poll(&plan->exchange, blocking, last ? &request->elbow : NULL,
+                                     (last && num_threads > 1) ? &request->opposite : NULL, num_threads)) return false;
+            if (last) {
+                request->phase = ISORT_MERGE;
+            } else {
+                request->step++;
+                request->phase = ISORT_POST;
+            }
+            break;
+        }
+
+        case ISORT_MERGE: {
+            // The merge overwrites the row the sends of the exchange read from
+            if (!sends_done(plan, blocking)) return false;
+            elem_t* source = plan->buffers[s->source];
+            elem_t* kept = plan->buffers[s->source ^ 1];
+            trace_begin(TRACE_MERGE, s->stage, -1, -1);
+            if (num_threads > 1) {
+                elbow_merge_parallel(kept, source, cols, request->elbow, request->opposite, s->ascending, num_threads);
+            } else {
+                elbow_merge(kept, source, cols, request->elbow, s->ascending);
+            }
+            trace_end();
+            request->result = s->source;
+            request->step++;
+            request->phase = (request->step < plan->num_steps) ? ISORT_POST : ISORT_FINISH;
+            break;
+        }
+
+        case ISORT_FINISH:
+            if (request->result != 0) memcpy(plan->buffers[0], plan->buffers[request->result], cols * sizeof(elem_t));
+            request->phase = ISORT_DONE;
+            break;
+
+        case ISORT_DONE:
+            return true;
+        }
+    }
+}
+
+
+// Progress thread: drives the whole sort with blocking waits
+static void* progress_thread(void* arg) {
+    bitonic_request_t* request = arg;
+    advance(request, true);
+    atomic_store(&request->done, true);
+    return NULL;
+}
+
+
+void bitonic_isort(bitonic_plan_t* plan, bitonic_request_t* request, bool progress_thread_wanted) {
+    request->plan = plan;
+    request->phase = ISORT_LOCAL_SORT;
+    request->step = 0;
+    request->count = plan->cols;
+    request->elbow = -1;
+    request->opposite = -1;
+    request->result = 0;
+    request->threaded = false;
+    atomic_init(&request->done, false);
+
+    if (!progress_thread_wanted) return;
+
+    // The thread calls MPI while the caller may call it too
+    int level;
+    MPI_Query_thread(&level);
+    if (level < MPI_THREAD_MULTIPLE) {
+        if (plan->rank == 0) printf("A progress thread needs MPI_THREAD_MULTIPLE: the sort advances in bitonic_test and bitonic_wait\n");
+        return;
+    }
+    if (pthread_create(&request->thread, NULL, progress_thread, request) != 0) {
+        fprintf(stderr, "Rank %d: Creating the progress thread failed\n", plan->rank);
+        MPI_Abort(plan->comm, -1);
+    }
+    request->threaded = true;
+}
+
+
+bool bitonic_test(bitonic_request_t* request) {
+    if (request->threaded) {
+        // The finished thread is joined here, so that a test loop needs no `bitonic_wait`
+        if (!atomic_load(&request->done)) return false;
+        pthread_join(request->thread, NULL);
+        request->threaded = false;
+        return true;
+    }
+    return advance(request, false);
+}
+
+
+void bitonic_wait(bitonic_request_t* request) {
+    if (request->threaded) {
+        pthread_join(request->thread, NULL);
+        request->threaded = false;
+        return;
+    }
+    advance(request, true);
+}
+
+
+void bitonic_plan_destroy(bitonic_plan_t* plan) {
+    if (plan->whole_row) {
+        chunk_exchange_free(&plan->exchange);
+        for (int i = 0; i < plan->num_requests; i++) {
+            MPI_Request_free(&plan->sends[i]);
+            MPI_Request_free(&plan->recvs[i]);
+        }
+    }
+    free(plan->sends);
+    free(plan->recvs);
+    free(plan->steps);
+    arena_unmap(plan->buffers[1], (size_t)plan->cols * sizeof(elem_t));
+    MPI_Comm_free(&plan->comm);
+    memset(plan, 0, sizeof(*plan));
+}
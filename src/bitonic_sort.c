@@ -1,27 +1,194 @@
 #include "../inc/bitonic_sort.h"
 
-// Version 4 (Optimized Memory Management - tested)
-#define CHUNK_DIVISOR        8      // Number of chunks to split the data into to transmit (must be power of 2)
-#define PRINT_TIME_LOGS      0      // 0: Do not print | 1: prints time measurements' logs if they cost more than `MIN_TIME_THRESHOLD`
-#define MIN_TIME_THRESHOLD   2.0    // Defines the minimum time threshold to be printed
+// Version 5 (Fused elbow search, allocation-free elbow merge - tested)
+// The chunk size of every step is picked at runtime (see `chunk_plan_create`) and the timings
+// are recorded by the runtime trace (`--trace`, see `trace.h`)
+
+// Partner of a row at a given stage and step
+int bitonic_partner(int rank, int stage, int step, bool flip) {
+    if (flip && step == stage - 1) return rank ^ ((1 << stage) - 1);  // Mirror inside the block
+    return rank ^ (1 << step);                                         // Hamming distance of one bit
+}
 
-void bitonic_sort(int* local_row, int rows, int cols, int rank) {
-    int stages = (int)log2(rows);
 
-    // Pre-allocate buffer for communications
-    int* received_row = malloc(cols * sizeof(int));
-    if (!received_row) {
+// Reverses a row in place
+static void reverse_row(elem_t* row, int cols) {
+    for (int i = 0, j = cols - 1; i < j; i++, j--) {
+        elem_t temp = row[i];
+        row[i] = row[j];
+        row[j] = temp;
+    }
+}
+
+
+// Compare-split variant (`--exchange split`): every row is kept sorted ascending, partners
+// only swap the elements that cross between them and no elbow merge is needed.
+// Works for any number of rows and any element counts up to `capacity` per row: missing rows
+// (up to the next power of two) and missing elements are virtual +infinity padding.
+static void bitonic_sort_split(elem_t* local_row, int* count, int capacity, int rows, int rank, bool presorted, MPI_Comm comm) {
+    int stages = 0;
+    while ((1 << stages) < rows) stages++;
+
+    // Receive buffer for the crossing elements, kept by the arena for the next sorts
+    elem_t* received_row = (elem_t*)arena_reserve(ARENA_SPARE, (size_t)capacity * sizeof(elem_t));
+
+    // Step 1: Every row is sorted ascending, the direction of a stage only decides which part is kept
+    if (!presorted) {
+        trace_begin(TRACE_LOCAL_SORT, -1, -1, -1);
+        local_sort(local_row, *count, true);
+        trace_end();
+    }
+    MPI_Barrier(comm);
+
+    // Step 2: Iterative bitonic stages of compare-splits.
+    // The stages use the "flip" form of the network: the first step pairs each row with its mirror
+    // inside the block (rank ^ (2^stage - 1)), so every compare-split keeps the low part on the lower
+    // rank. Already ordered neighbors then never cross, and nearly sorted inputs barely move.
+    // A virtual partner (>= rows) only holds +infinity and always sits above the real row, so that
+    // compare-split keeps the row as it is and is skipped without any communication.
+    for (int stage = 1; stage <= stages; stage++) {
+        for (int step = stage - 1; step >= 0; step--) {
+            int partner = bitonic_partner(rank, stage, step, true);
+
+            if (rank != partner && partner < rows) {
+                int tag = (stage << 8) | step;
+                bool keep_low = (rank < partner);
+
+                trace_begin(TRACE_COMPARE_SPLIT, stage, step, partner);
+                compare_split(local_row, received_row, capacity, count, partner, keep_low, tag, comm);
+                trace_end();
+            }
+        }
+    }
+}
+
+
+// Setup of the whole-row exchange that only depends on the communicator and the row length. The first
+// sort calibrates and reports it, then it is cached on the communicator (an MPI attribute) for the next
+// sorts and freed with it, or by `bitonic_sort_release`
+typedef struct {
+    int                cols;        // Row length of the chunk plan and of the window
+    bool               use_shm;     // The node's shared window exists (`--shm`, and some partner on the node)
+    shm_context_t      shm;         // Map of the node and its shared window, kept mapped for the next sorts
+    chunk_plan_t       chunks;      // Chunk size of every step
+    chunk_partitions_t partitions;  // Partitioned requests of every step (`--partitioned`), restarted by the next sorts
+} rows_context_t;
+
+static int rows_keyval = MPI_KEYVAL_INVALID;
+
+
+static int free_rows_context(MPI_Comm comm, int keyval, void* value, void* extra_state) {
+    (void)comm;
+    (void)keyval;
+    (void)extra_state;
+    rows_context_t* ctx = value;
+    chunk_partitions_free(&ctx->partitions);
+    shm_context_free(&ctx->shm);
+    free(ctx);
+    return MPI_SUCCESS;
+}
+
+
+// Cached setup of `comm` for rows of `cols` elements (collective when it has to be created)
+static rows_context_t* rows_context(int cols, int rank, MPI_Comm comm) {
+    if (rows_keyval == MPI_KEYVAL_INVALID) {
+        MPI_Comm_create_keyval(MPI_COMM_NULL_COPY_FN, free_rows_context, &rows_keyval, NULL);
+    }
+
+    rows_context_t* ctx;
+    int found;
+    MPI_Comm_get_attr(comm, rows_keyval, &ctx, &found);
+    if (found && ctx->cols == cols) return ctx;
+    if (found) MPI_Comm_delete_attr(comm, rows_keyval);
+
+    ctx = malloc(sizeof(rows_context_t));
+    if (!ctx) {
         fprintf(stderr, "Rank %d: Memory allocation failed\n", rank);
-        MPI_Abort(MPI_COMM_WORLD, -1);
+        MPI_Abort(comm, -1);
+    }
+    ctx->cols = cols;
+    chunk_partitions_init(&ctx->partitions);
+
+    // The window is only worth its two copies of the row when some partner shares the node. The
+    // map of the node also tells the chunk plan which steps stay on it (not compressed)
+    shm_context_create(&ctx->shm, cols, sort_config.use_shared_memory, comm);
+    ctx->use_shm = (ctx->shm.rows != NULL);
+
+    // Chunk size of every step, from the measured partner links (or `--chunk`)
+    trace_begin(TRACE_CALIBRATE, -1, -1, -1);
+    chunk_plan_create(&ctx->chunks, cols, sort_config.num_threads, &ctx->shm, comm);
+    trace_end();
+    chunk_plan_report(&ctx->chunks, cols, rank);
+
+    MPI_Comm_set_attr(comm, rows_keyval, ctx);
+    return ctx;
+}
+
+
+void bitonic_sort_release(MPI_Comm comm) {
+    if (rows_keyval == MPI_KEYVAL_INVALID) return;
+    void* ctx;
+    int found;
+    MPI_Comm_get_attr(comm, rows_keyval, &ctx, &found);
+    if (found) MPI_Comm_delete_attr(comm, rows_keyval);
+}
+
+
+// Whole-row exchange (`--exchange full`) on a power of two of equal rows
+static void bitonic_sort_rows(elem_t* local_row, int rows, int cols, int rank, bool presorted, MPI_Comm comm) {
+    int stages = (int)log2(rows);
+
+    // The two buffers swap roles after every message exchange and every elbow merge: `row` holds the
+    // data, `spare` receives the partner's row (then the kept elements) during the exchanges and the
+    // merged output at the end of each stage.
+    // With shared memory both live in the node's window, so that partners on the same node
+    // compare-exchange directly on each other's row instead of copying it.
+    // The window and the chunk sizes are set up by the first sort of these rows on `comm`.
+    rows_context_t* ctx = rows_context(cols, rank, comm);
+    const chunk_plan_t* plan = &ctx->chunks;
+    shm_context_t* shm = &ctx->shm;
+    bool use_shm = ctx->use_shm;
+    elem_t* received_row = NULL;
+    elem_t* row;
+    elem_t* spare;
+    int row_index = 0;  // Which of the two buffers holds the data (flips after every swap)
+
+    if (use_shm) {
+        row = shm->rows;
+        spare = shm->rows + cols;
+        memcpy(row, local_row, cols * sizeof(elem_t));
+    } else {
+        // Buffer for communications, mapped once and kept by the arena for the next sorts
+        received_row = (elem_t*)arena_reserve(ARENA_SPARE, (size_t)cols * sizeof(elem_t));
+        row = local_row;
+        spare = received_row;
     }
 
-    // Step 1: Initial alternating sorting
-    double start_time = MPI_Wtime();
-    initial_alternating_sort(local_row, cols, rank);
-    double end_time = MPI_Wtime();
-    if (end_time - start_time > MIN_TIME_THRESHOLD && PRINT_TIME_LOGS != 0) 
-        printf("Rank %d: initial_alternating_sort took %.6f seconds\n", rank, end_time - start_time);
-    MPI_Barrier(MPI_COMM_WORLD);
+    // Hybrid mode: one thread drives the exchanges, every thread compare-exchanges the landed chunks
+    // and runs the elbow merges
+    int num_threads = sort_config.num_threads;
+    chunk_exchange_t exchange;
+    chunk_exchange_init(&exchange, rank, comm);
+
+    // Partitioned requests stay bound to the buffers of the first sort. The steps through the window
+    // do not swap the buffers, so with it the partners' buffers may be out of phase: point-to-point chunks
+    chunk_partitions_t* parts = NULL;
+#if MPI_VERSION >= 4
+    if (sort_config.partitioned && !use_shm) {
+        parts = &ctx->partitions;
+        chunk_partitions_bind(parts, row, spare, comm);
+    }
+#endif
+
+    // Step 1: Initial alternating sorting (an ascending row only has to be reversed on odd ranks)
+    trace_begin(TRACE_LOCAL_SORT, -1, -1, -1);
+    if (!presorted) {
+        initial_alternating_sort(row, cols, rank);
+    } else if (rank % 2 != 0) {
+        reverse_row(row, cols);
+    }
+    trace_end();
+    MPI_Barrier(comm);
 
     // Step 2: Iterative bitonic stages
     for (int stage = 1; stage <= stages; stage++) {
@@ -29,60 +196,154 @@ void bitonic_sort(int* local_row, int rows, int cols, int rank) {
         int chunk_size = rows / num_chunks;
         int chunk = rank / chunk_size;
         bool is_ascending = (chunk % 2 == 0);
+        int elbow = -1, opposite = -1;
 
         // Communication based on Hamming distance for recursive steps
         for (int step = stage - 1; step >= 0; step--) {
-            int partner = rank ^ (1 << step);  // Compute partner based on Hamming distance
+            int partner = bitonic_partner(rank, stage, step, false);  // Compute partner based on Hamming distance
+
+            if (rank != partner && partner < rows && use_shm && shm_is_local(shm, partner)) {
+                // Same node: compare-exchange in place on both rows (the elbow is searched before the merge)
+                trace_begin(TRACE_SHM_EXCHANGE, stage, step, partner);
+                shm_pairwise_exchange(shm, row_index, rank, partner, is_ascending, num_threads, (stage << 8) | step, comm);
+                trace_end();
+            } else if (rank != partner && partner < rows) {
+                // The kept elements land in the spare buffer, chunk by chunk in completion order, while
+                // the sends of the row may still be in flight: the buffers swap roles after the exchange
+                trace_begin(TRACE_EXCHANGE, stage, step, partner);
+                bool pair_ascending = (rank < partner) ? is_ascending : !is_ascending;
+                chunk_exchange_run(&exchange, row, spare, cols, plan->chunk_elements[step], plan->max_ratio[step], partner, (stage << 8) | step,
+                                   parts, step, pair_ascending, is_ascending, (step == 0) ? &elbow : NULL,
+                                   (step == 0 && num_threads > 1) ? &opposite : NULL, num_threads, comm);
+                elem_t* kept = spare;
+                spare = row;
+                row = kept;
+                row_index ^= 1;
+                trace_end();
+            }
+        }
+
+        // Local elbow sort after each stage: merge into the spare buffer (once the last sends
+        // from it are done) and swap the buffers
+        trace_begin(TRACE_MERGE, stage, -1, -1);
+        chunk_exchange_complete(&exchange);
+        if (elbow < 0) elbow = find_elbow_element(row, cols, is_ascending);
+        if (num_threads > 1) {
+            if (opposite < 0) opposite = find_elbow_element(row, cols, !is_ascending);
+            elbow_merge_parallel(row, spare, cols, elbow, opposite, is_ascending, num_threads);
+        } else {
+            elbow_merge(row, spare, cols, elbow, is_ascending);
+        }
+        elem_t* merged = spare;
+        spare = row;
+        row = merged;
+        row_index ^= 1;
+        trace_end();
+    }
+
+    // After an odd number of swaps (or always, with shared memory) the sorted data lives in the other buffer
+    if (row != local_row) {
+        memcpy(local_row, row, cols * sizeof(elem_t));
+    }
+
+    // Clean up (the window stays mapped for the next sorts)
+    chunk_exchange_free(&exchange);
+}
+
+
+// Streaming whole-row exchange (`--exchange stream`) on a power of two of equal rows of a power of two
+// of elements, without any second row: the partner's row flows through the ring of staging blocks, and
+// the initial sort and the merges at the end of the stages run in place on the row with the scratch of
+// a few blocks. The memory stays about one row plus a constant, at the cost of log2(cols / block)
+// half-cleaner passes per merge instead of a single elbow merge.
+static void bitonic_sort_stream(elem_t* local_row, int rows, int cols, int rank, bool presorted, MPI_Comm comm) {
+    int stages = (int)log2(rows);
+    int num_threads = sort_config.num_threads;
+    int block = stream_exchange_block(cols);
+
+    // Reported by the first sort (and again only if the block size changes)
+    static int reported_block = 0;
+    if (rank == 0 && block != reported_block) {
+        printf("Streaming exchange: %d-element blocks, %d in flight\n", block, STREAM_RING);
+        reported_block = block;
+    }
+
+    stream_exchange_t exchange;
+    stream_exchange_init(&exchange, block);
+
+    // Step 1: Initial alternating sorting, in place
+    trace_begin(TRACE_LOCAL_SORT, -1, -1, -1);
+    if (!presorted) {
+        bitonic_sort_bounded(local_row, cols, stream_sort_block(cols, block), rank % 2 == 0, num_threads);
+    } else if (rank % 2 != 0) {
+        reverse_row(local_row, cols);
+    }
+    trace_end();
+    MPI_Barrier(comm);
+
+    // Step 2: Iterative bitonic stages, as in `bitonic_sort_rows`
+    for (int stage = 1; stage <= stages; stage++) {
+        int num_chunks = 1 << (stages - stage);
+        int chunk_size = rows / num_chunks;
+        int chunk = rank / chunk_size;
+        bool is_ascending = (chunk % 2 == 0);
 
+        for (int step = stage - 1; step >= 0; step--) {
+            int partner = bitonic_partner(rank, stage, step, false);
             if (rank != partner && partner < rows) {
-                int base_tag = (stage << 8) | step; // Combine stage and step into a unique tag
-
-                // Determine chunk size
-                int chunk_count = CHUNK_DIVISOR;
-                int chunk_elements = (cols + chunk_count - 1) / chunk_count;
-                MPI_Request send_request[chunk_count], recv_request[chunk_count];
-
-                start_time = MPI_Wtime(); // Start timing for the entire send/receive process
-                for (int chunk_idx = 0; chunk_idx < chunk_count; chunk_idx++) {
-                    int offset = chunk_idx * chunk_elements;
-                    int current_chunk_size = (offset + chunk_elements <= cols) ? chunk_elements : cols - offset;
-
-                    if (current_chunk_size > 0) {
-                        int send_tag = (chunk_idx << 16) | base_tag;
-                        int recv_tag = (chunk_idx << 16) | base_tag;
-
-                        MPI_Isend(local_row + offset, current_chunk_size, MPI_INT, partner, send_tag, MPI_COMM_WORLD, &send_request[chunk_idx]);
-                        MPI_Irecv(received_row + offset, current_chunk_size, MPI_INT, partner, recv_tag, MPI_COMM_WORLD, &recv_request[chunk_idx]);
-                    }
-                }
-
-                // Wait for each communication to complete and perform pairwise sort
-                for (int chunk_idx = 0; chunk_idx < chunk_count; chunk_idx++) {
-                    int offset = chunk_idx * chunk_elements;
-                    int current_chunk_size = (offset + chunk_elements <= cols) ? chunk_elements : cols - offset;
-
-                    if (current_chunk_size > 0) {
-                        MPI_Wait(&send_request[chunk_idx], MPI_STATUS_IGNORE);
-                        MPI_Wait(&recv_request[chunk_idx], MPI_STATUS_IGNORE);
-                        pairwise_sort(local_row + offset, received_row + offset, current_chunk_size, (rank < partner) ? is_ascending : !is_ascending);
-                    }
-                }
-                end_time = MPI_Wtime();
-                if (end_time - start_time > MIN_TIME_THRESHOLD && PRINT_TIME_LOGS != 0) 
-                    printf("Rank %d: Entire send/receive process and pairwise_sort took %.6f seconds\n", rank, end_time - start_time);
+                trace_begin(TRACE_EXCHANGE, stage, step, partner);
+                bool pair_ascending = (rank < partner) ? is_ascending : !is_ascending;
+                stream_exchange_run(&exchange, local_row, cols, partner, (stage << 8) | step, pair_ascending, num_threads, comm);
+                trace_end();
             }
         }
 
-        // Local elbow sort after each stage
-        start_time = MPI_Wtime();
-        elbow_sort(local_row, cols, is_ascending);
-        end_time = MPI_Wtime();
-        if (end_time - start_time > MIN_TIME_THRESHOLD && PRINT_TIME_LOGS != 0) 
-            printf("Rank %d: elbow_sort for stage %d took %.6f seconds\n", rank, stage, end_time - start_time);
+        trace_begin(TRACE_MERGE, stage, -1, -1);
+        bitonic_merge_bounded(local_row, cols, block, is_ascending, num_threads);
+        trace_end();
+    }
+
+    stream_exchange_free(&exchange);
+}
+
+
+void bitonic_sort_any(elem_t* local_row, int* count, int capacity, bool presorted, MPI_Comm comm) {
+    int rank, rows;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &rows);
+
+    // The whole-row exchange needs equal rows and a power of two of them
+    int uniform = (*count == capacity);
+    MPI_Allreduce(MPI_IN_PLACE, &uniform, 1, MPI_INT, MPI_LAND, comm);
+    bool power_of_two = (rows & (rows - 1)) == 0;
+
+    if (sort_config.exchange_mode == EXCHANGE_FULL && uniform && power_of_two) {
+        bitonic_sort_rows(local_row, rows, capacity, rank, presorted, comm);
+        return;
+    }
+
+    // The in-place merges of the streaming exchange also need a power of two of elements per row
+    if (sort_config.exchange_mode == EXCHANGE_STREAM && uniform && power_of_two && (capacity & (capacity - 1)) == 0) {
+        bitonic_sort_stream(local_row, rows, capacity, rank, presorted, comm);
+        return;
     }
 
-    // Clean up
-    free(received_row);
+    if (sort_config.exchange_mode != EXCHANGE_SPLIT && rank == 0) 
+        printf("Uneven rows or a non power of two number of processes%s: using the compare-split exchange\n",
+               sort_config.exchange_mode == EXCHANGE_STREAM ? " or elements" : "");
+    bitonic_sort_split(local_row, count, capacity, rows, rank, presorted, comm);
+}
+
+
+void bitonic_sort(elem_t* local_row, int rows, int cols, int rank) {
+    if (sort_config.exchange_mode == EXCHANGE_SPLIT) {
+        int count = cols;
+        bitonic_sort_split(local_row, &count, cols, rows, rank, false, MPI_COMM_WORLD);
+    } else if (sort_config.exchange_mode == EXCHANGE_STREAM) {
+        bitonic_sort_stream(local_row, rows, cols, rank, false, MPI_COMM_WORLD);
+    } else {
+        bitonic_sort_rows(local_row, rows, cols, rank, false, MPI_COMM_WORLD);
+    }
 }
 
 
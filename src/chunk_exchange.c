@@ -0,0 +1,404 @@
+#include "../inc/chunk_exchange.h"
+
+
+void chunk_exchange_init(chunk_exchange_t* ex, int rank, MPI_Comm comm) {
+    ex->sends = malloc(MAX_CHUNKS * sizeof(MPI_Request));
+    ex->recvs = malloc(MAX_CHUNKS * sizeof(MPI_Request));
+    ex->indices = malloc(MAX_CHUNKS * sizeof(int));
+    ex->chunk_elbow = malloc(MAX_CHUNKS * sizeof(int));
+    ex->chunk_opposite = malloc(MAX_CHUNKS * sizeof(int));
+    ex->arrived = malloc(MAX_CHUNKS * sizeof(bool));
+    ex->statuses = malloc(MAX_CHUNKS * sizeof(MPI_Status));
+    if (!ex->sends || !ex->recvs || !ex->indices || !ex->chunk_elbow || !ex->chunk_opposite || !ex->arrived || !ex->statuses) {
+        fprintf(stderr, "Rank %d: Memory allocation failed\n", rank);
+        MPI_Abort(comm, -1);
+    }
+    ex->in_flight = ex->sends;
+    ex->pending = 0;
+    ex->compressed = false;
+    ex->wire_send = NULL;
+    ex->wire_recv = NULL;
+    ex->wire_stride = 0;
+    ex->wire_capacity = 0;
+
+#if MPI_VERSION < 4
+    if (sort_config.partitioned && rank == 0)
+        printf("Partitioned requests need MPI 4 (this library implements MPI %d.%d): using point-to-point chunks\n", MPI_VERSION, MPI_SUBVERSION);
+#endif
+}
+
+
+void chunk_exchange_complete(chunk_exchange_t* ex) {
+    if (ex->pending == 0) return;
+
+    trace_wait_begin();
+    MPI_Waitall(ex->pending, ex->in_flight, MPI_STATUSES_IGNORE);
+    trace_wait_end();
+    ex->pending = 0;
+}
+
+
+bool chunk_exchange_test_sends(chunk_exchange_t* ex) {
+    if (ex->pending == 0) return true;
+
+    int flag;
+    MPI_Testall(ex->pending, ex->in_flight, &flag, MPI_STATUSES_IGNORE);
+    if (!flag) return false;
+    ex->pending = 0;
+    return true;
+}
+
+
+void chunk_exchange_free(chunk_exchange_t* ex) {
+    chunk_exchange_complete(ex);
+    free(ex->sends);
+    free(ex->recvs);
+    free(ex->indices);
+    free(ex->chunk_elbow);
+    free(ex->chunk_opposite);
+    free(ex->arrived);
+    free(ex->statuses);
+    free(ex->wire_send);
+    free(ex->wire_recv);
+}
+
+
+void chunk_partitions_init(chunk_partitions_t* parts) {
+    parts->buffers[0] = parts->buffers[1] = NULL;
+    for (int s = 0; s < MAX_EXCHANGE_STEPS; s++) {
+        for (int i = 0; i < 2; i++) {
+            parts->sends[s][i] = MPI_REQUEST_NULL;
+            parts->recvs[s][i] = MPI_REQUEST_NULL;
+        }
+    }
+}
+
+
+void chunk_partitions_bind(chunk_partitions_t* parts, elem_t* row, elem_t* spare, MPI_Comm comm) {
+    // The requests are matched in creation order, so they are only created again if the partners do it too
+    int moved = (row != parts->buffers[0] || spare != parts->buffers[1]);
+    MPI_Allreduce(MPI_IN_PLACE, &moved, 1, MPI_INT, MPI_LOR, comm);
+    if (!moved) return;
+
+    chunk_partitions_free(parts);
+    parts->buffers[0] = row;
+    parts->buffers[1] = spare;
+}
+
+
+void chunk_partitions_free(chunk_partitions_t* parts) {
+    for (int s = 0; s < MAX_EXCHANGE_STEPS; s++) {
+        for (int i = 0; i < 2; i++) {
+            if (parts->sends[s][i] != MPI_REQUEST_NULL) MPI_Request_free(&parts->sends[s][i]);
+            if (parts->recvs[s][i] != MPI_REQUEST_NULL) MPI_Request_free(&parts->recvs[s][i]);
+        }
+    }
+}
+
+
+// Point-to-point chunks: one send and one receive per chunk, the chunk index above the tag
+static void post_chunks(chunk_exchange_t* ex, const elem_t* row, elem_t* spare, int cols, int chunk_elements,
+                        int chunk_count, int partner, int tag, MPI_Comm comm) {
+    for (int c = 0; c < chunk_count; c++) {
+        int offset = c * chunk_elements;
+        int len = (offset + chunk_elements <= cols) ? chunk_elements : cols - offset;
+        MPI_Irecv(spare + offset, len, elem_mpi_type(), partner, (c << 16) | tag, comm, &ex->recvs[c]);
+    }
+    for (int c = 0; c < chunk_count; c++) {
+        int offset = c * chunk_elements;
+        int len = (offset + chunk_elements <= cols) ? chunk_elements : cols - offset;
+        MPI_Isend((void*)(row + offset), len, elem_mpi_type(), partner, (c << 16) | tag, comm, &ex->sends[c]);
+    }
+    ex->in_flight = ex->sends;
+    ex->pending = chunk_count;
+}
+
+
+int chunk_exchange_persistent_init(MPI_Request* sends, MPI_Request* recvs, const elem_t* row, elem_t* spare, int cols,
+                                   int chunk_elements, int partner, int tag, MPI_Comm comm) {
+    int chunk_count = (cols + chunk_elements - 1) / chunk_elements;
+    for (int c = 0; c < chunk_count; c++) {
+        int offset = c * chunk_elements;
+        int len = (offset + chunk_elements <= cols) ? chunk_elements : cols - offset;
+        MPI_Recv_init(spare + offset, len, elem_mpi_type(), partner, (c << 16) | tag, comm, &recvs[c]);
+        MPI_Send_init((void*)(row + offset), len, elem_mpi_type(), partner, (c << 16) | tag, comm, &sends[c]);
+    }
+    return chunk_count;
+}
+
+
+// Compressed chunks: each chunk is encoded and sent right away, the receives take the largest encoding.
+// Once a chunk does not pack well enough, the rest of the row travels raw (its density changes slowly)
+static void post_compressed(chunk_exchange_t* ex, const elem_t* row, int cols, int chunk_elements, int chunk_count,
+                            double max_ratio, int partner, int tag, MPI_Comm comm) {
+    size_t stride = wire_bound(chunk_elements);
+    if (stride * chunk_count > ex->wire_capacity) {
+        free(ex->wire_send);
+        free(ex->wire_recv);
+        ex->wire_capacity = stride * chunk_count;
+        ex->wire_send = malloc(ex->wire_capacity);
+        ex->wire_recv = malloc(ex->wire_capacity);
+        if (!ex->wire_send || !ex->wire_recv) {
+            int rank;
+            MPI_Comm_rank(comm, &rank);
+            fprintf(stderr, "Rank %d: Memory allocation failed\n", rank);
+            MPI_Abort(comm, -1);
+        }
+    }
+    ex->wire_stride = stride;
+
+    for (int c = 0; c < chunk_count; c++) {
+        MPI_Irecv(ex->wire_recv + c * stride, (int)stride, MPI_BYTE, partner, (c << 16) | tag, comm, &ex->recvs[c]);
+    }
+    long long sent = 0;
+    for (int c = 0; c < chunk_count; c++) {
+        int offset = c * chunk_elements;
+        int len = (offset + chunk_elements <= cols) ? chunk_elements : cols - offset;
+        size_t bytes = wire_encode(row + offset, len, max_ratio, ex->wire_send + c * stride);
+        if (!((const wire_header_t*)(ex->wire_send + c * stride))->packed) max_ratio = 0.0;
+        MPI_Isend(ex->wire_send + c * stride, (int)bytes, MPI_BYTE, partner, (c << 16) | tag, comm, &ex->sends[c]);
+        sent += (long long)bytes;
+    }
+    ex->in_flight = ex->sends;
+    ex->pending = chunk_count;
+    trace_bytes(sent, 0);
+}
+
+
+#if MPI_VERSION >= 4
+// Partitioned requests: a single send and receive of `chunk_count` equal partitions, created by the
+// first exchange of the step in this direction and restarted by the next ones. Their tag is the step
+// alone, below the stage bits of the point-to-point tags. Returns the receive to poll
+static MPI_Request* post_partitioned(chunk_exchange_t* ex, chunk_partitions_t* parts, int step, const elem_t* row,
+                                     elem_t* spare, int chunk_elements, int chunk_count, int partner, MPI_Comm comm) {
+    int source = (row == parts->buffers[0]) ? 0 : 1;
+    MPI_Request* send = &parts->sends[step][source];
+    MPI_Request* recv = &parts->recvs[step][source];
+    if (*send == MPI_REQUEST_NULL) {
+        MPI_Precv_init(spare, chunk_count, chunk_elements, elem_mpi_type(), partner, step, comm, MPI_INFO_NULL, recv);
+        MPI_Psend_init((void*)row, chunk_count, chunk_elements, elem_mpi_type(), partner, step, comm, MPI_INFO_NULL, send);
+    }
+    MPI_Start(recv);
+    MPI_Start(send);
+
+    // The whole row is already in place: every partition can leave at once
+    MPI_Pready_range(0, chunk_count - 1, *send);
+    ex->in_flight = send;
+    ex->pending = 1;
+    return recv;
+}
+#endif
+
+
+// Waits until at least one more chunk has landed and lists the new ones in `ex->indices`
+static int next_landed(chunk_exchange_t* ex, MPI_Request* recvs, int chunk_count, bool partitioned) {
+    if (!partitioned) {
+        int done;
+        MPI_Waitsome(chunk_count, recvs, &done, ex->indices, ex->compressed ? ex->statuses : MPI_STATUSES_IGNORE);
+        return done;
+    }
+
+    // Nothing blocks on a partition: after a few empty polls the thread yields, then sleeps
+    // longer and longer, so that it leaves the core to the threads compare-exchanging the chunks
+    int done = 0;
+#if MPI_VERSION >= 4
+    long pause = 0;
+    for (int polls = 0; done == 0; polls++) {
+        for (int c = 0; c < chunk_count; c++) {
+            int flag = 0;
+            if (!ex->arrived[c]) MPI_Parrived(recvs[0], c, &flag);
+            if (flag) {
+                ex->arrived[c] = true;
+                ex->indices[done++] = c;
+            }
+        }
+        if (done > 0 || polls < PARRIVED_SPINS) continue;
+        if (pause == 0) {
+            pause = 1000;
+            sched_yield();
+        } else {
+            struct timespec sleep = { 0, pause };
+            nanosleep(&sleep, NULL);
+            if (pause < PARRIVED_MAX_SLEEP) pause *= 2;
+        }
+    }
+#endif
+    return done;
+}
+
+
+// Compare-exchange of a landed chunk, the kept elements overwrite the received ones
+static void process_chunk(chunk_exchange_t* ex, int c, const elem_t* row, elem_t* spare, int cols, int chunk_elements,
+                          bool keep_min, bool find_min, bool want_elbow, bool want_opposite) {
+    int offset = c * chunk_elements;
+    int len = (offset + chunk_elements <= cols) ? chunk_elements : cols - offset;
+    if (ex->compressed) wire_decode(ex->wire_recv + c * ex->wire_stride, spare + offset);
+
+    if (want_elbow) {
+        ex->chunk_elbow[c] = offset + pairwise_keep_elbow(row + offset, spare + offset, len, keep_min, find_min,
+                                                          want_opposite ? &ex->chunk_opposite[c] : NULL);
+        if (want_opposite) ex->chunk_opposite[c] += offset;
+    } else {
+        pairwise_keep(row + offset, spare + offset, len, keep_min);
+    }
+}
+
+
+// Combines the extremes of the chunks in row order, so the first one wins ties
+static void combine_extremes(const chunk_exchange_t* ex, const elem_t* spare, int chunk_count, bool find_min, int* elbow, int* opposite) {
+    *elbow = -1;
+    if (opposite) *opposite = -1;
+    for (int c = 0; c < chunk_count; c++) {
+        int e = ex->chunk_elbow[c], o = ex->chunk_opposite[c];
+        if (*elbow < 0 || (find_min ? KEY(spare[e]) < KEY(spare[*elbow]) : KEY(spare[e]) > KEY(spare[*elbow]))) *elbow = e;
+        if (opposite && (*opposite < 0 || (find_min ? KEY(spare[o]) > KEY(spare[*opposite]) : KEY(spare[o]) < KEY(spare[*opposite])))) *opposite = o;
+    }
+}
+
+
+// Progress engine: the master thread completes the receives in any order and hands every landed
+// chunk to a task, the other threads compare-exchange them meanwhile. Then the extremes are combined
+static void progress_chunks(chunk_exchange_t* ex, MPI_Request* recvs, int chunk_count, bool partitioned, const elem_t* row,
+                            elem_t* spare, int cols, int chunk_elements, bool keep_min, bool find_min, int* elbow,
+                            int* opposite, int num_threads) {
+    bool want_elbow = (elbow != NULL);
+    bool want_opposite = (opposite != NULL);
+
+    #pragma omp parallel num_threads(num_threads)
+    #pragma omp master
+    {
+        int landed = 0;
+        while (landed < chunk_count) {
+            trace_wait_begin();
+            int done = next_landed(ex, recvs, chunk_count, partitioned);
+            trace_wait_end();
+            if (ex->compressed) {
+                long long received = 0;
+                for (int i = 0; i < done; i++) {
+                    int bytes;
+                    MPI_Get_count(&ex->statuses[i], MPI_BYTE, &bytes);
+                    received += bytes;
+                }
+                trace_bytes(0, received);
+            }
+            for (int i = 0; i < done; i++) {
+                int c = ex->indices[i];
+                #pragma omp task firstprivate(c) if(num_threads > 1)
+                process_chunk(ex, c, row, spare, cols, chunk_elements, keep_min, find_min, want_elbow, want_opposite);
+            }
+            landed += done;
+        }
+        #pragma omp taskwait
+    }
+
+    if (partitioned) {
+        trace_wait_begin();
+        MPI_Wait(&recvs[0], MPI_STATUS_IGNORE);
+        trace_wait_end();
+    }
+
+    if (want_elbow) combine_extremes(ex, spare, chunk_count, find_min, elbow, opposite);
+}
+
+
+void chunk_exchange_run(chunk_exchange_t* ex, const elem_t* row, elem_t* spare, int cols, int chunk_elements,
+                        double max_ratio, int partner, int tag, chunk_partitions_t* parts, int step, bool keep_min,
+                        bool find_min, int* elbow, int* opposite, int num_threads, MPI_Comm comm) {
+    int chunk_count = (cols + chunk_elements - 1) / chunk_elements;
+
+    // The previous sends may still read from `spare` (or from the encoded chunks)
+    chunk_exchange_complete(ex);
+
+    // Compressed chunks have their own sizes, so they never travel as partitions
+    ex->compressed = (max_ratio > 0.0);
+    if (ex->compressed) {
+        post_compressed(ex, row, cols, chunk_elements, chunk_count, max_ratio, partner, tag, comm);
+        progress_chunks(ex, ex->recvs, chunk_count, false, row, spare, cols, chunk_elements, keep_min, find_min,
+                        elbow, opposite, num_threads);
+        return;
+    }
+
+    // Partitions must all have the same size
+    bool partitioned = false;
+    MPI_Request* recvs = ex->recvs;
+#if MPI_VERSION >= 4
+    partitioned = (parts != NULL) && cols % chunk_elements == 0;
+    if (partitioned) {
+        memset(ex->arrived, 0, chunk_count * sizeof(bool));
+        recvs = post_partitioned(ex, parts, step, row, spare, chunk_elements, chunk_count, partner, comm);
+    }
+#else
+    (void)parts;
+    (void)step;
+#endif
+    if (!partitioned) post_chunks(ex, row, spare, cols, chunk_elements, chunk_count, partner, tag, comm);
+    trace_bytes((long long)cols * sizeof(elem_t), (long long)cols * sizeof(elem_t));
+
+    progress_chunks(ex, recvs, chunk_count, partitioned, row, spare, cols, chunk_elements, keep_min, find_min,
+                    elbow, opposite, num_threads);
+}
+
+
+void chunk_exchange_start(chunk_exchange_t* ex, MPI_Request* sends, MPI_Request* recvs, const elem_t* row, elem_t* spare,
+                          int cols, int chunk_elements, bool keep_min, bool find_min, int* elbow, int* opposite,
+                          int num_threads) {
+    int chunk_count = (cols + chunk_elements - 1) / chunk_elements;
+
+    // The previous sends may still read from `spare`
+    chunk_exchange_complete(ex);
+
+    MPI_Startall(chunk_count, recvs);
+    MPI_Startall(chunk_count, sends);
+    ex->in_flight = sends;
+    ex->pending = chunk_count;
+    ex->compressed = false;
+    trace_bytes((long long)cols * sizeof(elem_t), (long long)cols * sizeof(elem_t));
+
+    progress_chunks(ex, recvs, chunk_count, false, row, spare, cols, chunk_elements, keep_min, find_min,
+                    elbow, opposite, num_threads);
+}
+
+
+void chunk_exchange_post(chunk_exchange_t* ex, MPI_Request* sends, MPI_Request* recvs, const elem_t* row, elem_t* spare,
+                         int cols, int chunk_elements, bool keep_min, bool find_min) {
+    ex->landing = recvs;
+    ex->row = row;
+    ex->spare = spare;
+    ex->cols = cols;
+    ex->chunk_elements = chunk_elements;
+    ex->chunk_count = (cols + chunk_elements - 1) / chunk_elements;
+    ex->landed = 0;
+    ex->keep_min = keep_min;
+    ex->find_min = find_min;
+    ex->compressed = false;
+
+    MPI_Startall(ex->chunk_count, recvs);
+    MPI_Startall(ex->chunk_count, sends);
+    ex->in_flight = sends;
+    ex->pending = ex->chunk_count;
+    trace_bytes((long long)cols * sizeof(elem_t), (long long)cols * sizeof(elem_t));
+}
+
+
+bool chunk_exchange_poll(chunk_exchange_t* ex, bool blocking, int* elbow, int* opposite, int num_threads) {
+    if (ex->landed < ex->chunk_count) {
+        int done;
+        if (blocking) {
+            MPI_Waitsome(ex->chunk_count, ex->landing, &done, ex->indices, MPI_STATUSES_IGNORE);
+        } else {
+            MPI_Testsome(ex->chunk_count, ex->landing, &done, ex->indices, MPI_STATUSES_IGNORE);
+        }
+
+        // The landed chunks are shared by the threads
+        #pragma omp parallel for num_threads(num_threads) schedule(dynamic, 1) if(done > 1 && num_threads > 1)
+        for (int i = 0; i < done; i++) {
+            process_chunk(ex, ex->indices[i], ex->row, ex->spare, ex->cols, ex->chunk_elements, ex->keep_min,
+                          ex->find_min, elbow != NULL, opposite != NULL);
+        }
+        ex->landed += done;
+        if (ex->landed < ex->chunk_count) return false;
+    }
+
+    if (elbow) combine_extremes(ex, ex->spare, ex->chunk_count, ex->find_min, elbow, opposite);
+    return true;
+}
@@ -0,0 +1,151 @@
+#include "../inc/compare_split.h"
+
+// Naming used below: L is the row of the `keep_low` side and H the row of the other side, both
+// seen as `capacity` long with +infinity after their last element. The cut point k is the number
+// of elements that cross: the top k of L go to H and the bottom k of H go to L. It is the first k
+// for which L[capacity - 1 - k] <= H[k] (or k == capacity). Padding slots are never sent.
+
+// Finds the cut point with rounds of splitter exchanges: both partners probe the same
+// candidate cuts, so they narrow [lo, hi] identically without any extra agreement step.
+// Probes that fall on padding are not sent: the low side probes downwards from the top of its row
+// and the high side upwards from the bottom, so the padded probes are always the first ones of
+// the low side and the last ones of the high side, and the received count tells them apart.
+int compare_split_cut(compare_split_key_t key_at, const void* row, int capacity, int count, int partner, bool keep_low,
+                      int tag, MPI_Comm comm) {
+    int lo = 0, hi = capacity;      // The cut lies in [lo, hi]
+    int probes[SPLIT_PROBES];
+    sort_key_t mine[SPLIT_PROBES], theirs[SPLIT_PROBES];
+
+    while (lo < hi) {
+        // Evenly spaced candidates in [lo, hi - 1] (all of them once the range is small)
+        int span = hi - lo;
+        int num_probes = (span < SPLIT_PROBES) ? span : SPLIT_PROBES;
+        int first_real = 0, num_real = 0;   // Occupied probes of this side: [first_real, first_real + num_real)
+        for (int i = 0; i < num_probes; i++) {
+            probes[i] = lo + (int)((long long)span * i / num_probes);
+            int position = keep_low ? capacity - 1 - probes[i] : probes[i];
+            if (position < count) {
+                mine[i] = key_at(row, position);
+                num_real++;
+            } else if (keep_low) {
+                first_real++;
+            }
+        }
+
+        MPI_Status status;
+        int received;
+        trace_wait_begin();
+        MPI_Sendrecv(mine + first_real, num_real, KEY_MPI_TYPE, partner, tag, theirs, num_probes, KEY_MPI_TYPE, partner, tag,
+                     comm, &status);
+        trace_wait_end();
+        MPI_Get_count(&status, KEY_MPI_TYPE, &received);
+        trace_bytes((long long)num_real * sizeof(sort_key_t), (long long)received * sizeof(sort_key_t));
+
+        // The partner's occupied probes, aligned with `probes`
+        int their_first = keep_low ? 0 : num_probes - received;
+        if (their_first > 0) memmove(theirs + their_first, theirs, (size_t)received * sizeof(sort_key_t));
+
+        // The "still crossing" predicate is monotone: true below the cut, false from the cut on.
+        // A padding slot is +infinity: it crosses against any element, never against padding.
+        int new_lo = lo, new_hi = hi;
+        for (int i = 0; i < num_probes; i++) {
+            bool mine_pad   = (i < first_real) || (i >= first_real + num_real);
+            bool theirs_pad = (i < their_first) || (i >= their_first + received);
+            bool low_pad  = keep_low ? mine_pad : theirs_pad;
+            bool high_pad = keep_low ? theirs_pad : mine_pad;
+
+            bool crossing;
+            if (high_pad) {
+                crossing = false;
+            } else if (low_pad) {
+                crossing = true;
+            } else {
+                sort_key_t low_value  = keep_low ? mine[i] : theirs[i];
+                sort_key_t high_value = keep_low ? theirs[i] : mine[i];
+                crossing = (low_value > high_value);
+            }
+
+            if (crossing) {
+                new_lo = probes[i] + 1;
+            } else {
+                new_hi = probes[i];
+                break;
+            }
+        }
+        lo = new_lo;
+        hi = new_hi;
+    }
+    return lo;
+}
+
+
+// Probed keys of a row in memory
+static sort_key_t memory_key(const void* row, int position) {
+    return KEY(((const elem_t*)row)[position]);
+}
+
+
+// Low side: the kept prefix row[0, kept) is merged with the `received` elements from the back,
+// the write position never passes the read position of the kept part
+static void merge_low_in_place(elem_t* row, int kept, const elem_t* received, int num_received) {
+    int i = kept - 1;
+    int j = num_received - 1;
+    for (int p = kept + num_received - 1; j >= 0; p--) {
+        bool take_row = (i >= 0) && (KEY(row[i]) > KEY(received[j]));
+        row[p] = take_row ? row[i] : received[j];
+        i -= take_row;
+        j -= !take_row;
+    }
+}
+
+
+// High side: the kept part row[first, count) is merged with the `received` elements from the front
+static void merge_high_in_place(elem_t* row, int first, int count, const elem_t* received, int num_received) {
+    int i = first;
+    int j = 0;
+    for (int p = 0; j < num_received || i < count; p++) {
+        bool take_row = (j >= num_received) || ((i < count) && (KEY(row[i]) < KEY(received[j])));
+        row[p] = take_row ? row[i] : received[j];
+        i += take_row;
+        j += !take_row;
+    }
+}
+
+
+// Compare-split of two sorted (virtually padded) rows, moving only the crossing elements
+int compare_split(elem_t* row, elem_t* buffer, int capacity, int* count, int partner, bool keep_low, int tag, MPI_Comm comm) {
+    int n = *count;
+    int cut = compare_split_cut(memory_key, row, capacity, n, partner, keep_low, tag, comm);
+    if (cut == 0) return 0;  // The ranges do not overlap: nothing crosses
+
+    // The low side gives away its top `cut` slots, the high side its bottom `cut` slots;
+    // only the occupied ones are sent, and both sides know how many the other one holds there
+    int send_first, send_count;
+    if (keep_low) {
+        send_first = capacity - cut;
+        send_count = (n > send_first) ? n - send_first : 0;
+    } else {
+        send_first = 0;
+        send_count = (n < cut) ? n : cut;
+    }
+
+    MPI_Status status;
+    int num_received;
+    trace_wait_begin();
+    MPI_Sendrecv(row + send_first, send_count, elem_mpi_type(), partner, tag, buffer, capacity, elem_mpi_type(), partner, tag,
+                 comm, &status);
+    trace_wait_end();
+    MPI_Get_count(&status, elem_mpi_type(), &num_received);
+    trace_bytes((long long)send_count * sizeof(elem_t), (long long)num_received * sizeof(elem_t));
+
+    if (keep_low) {
+        int kept = (n < capacity - cut) ? n : capacity - cut;
+        merge_low_in_place(row, kept, buffer, num_received);
+        *count = kept + num_received;
+    } else {
+        int first = (n < cut) ? n : cut;
+        merge_high_in_place(row, first, n, buffer, num_received);
+        *count = (n - first) + num_received;
+    }
+    return send_count;
+}
@@ -0,0 +1,326 @@
+#include "../inc/config.h"
+
+// Names of the input distributions (`--dist`)
+const char* const input_dist_names[INPUT_NUM_DISTS] = {
+    "uniform", "sorted", "reversed", "nearly-sorted", "zipf", "equal", "organ-pipe"
+};
+
+// Defaults of the runtime settings
+sort_config_t sort_config = {
+    .num_threads = 1,
+    .engine = ENGINE_AUTO,
+    .exchange_mode = EXCHANGE_FULL,
+    .chunk_bytes = 0,
+    .compress = COMPRESS_AUTO,
+    .partitioned = false,
+    .total_elements = 0,
+    .input_dist = INPUT_UNIFORM,
+    .seed = 1,
+    .input_path = NULL,
+    .output_path = NULL,
+    .io_overlap = false,
+    .memory_budget = 0,
+    .scratch_dir = NULL,
+    .hugepages = HUGEPAGES_THP,
+    .use_shared_memory = true,
+    .remap_ranks = true,
+    .trace_prefix = NULL,
+    .trace_counters = false,
+};
+
+
+// Parses a base-10 integer no smaller than `min`
+static bool parse_int(const char* value, int min, int* out) {
+    char* end;
+    long parsed = strtol(value, &end, 10);
+    if (end == value || *end != '\0' || parsed < min || parsed > 1 << 30) return false;
+    *out = (int)parsed;
+    return true;
+}
+
+
+// Parses a base-10 64-bit integer no smaller than `min`
+static bool parse_long(const char* value, long long min, long long* out) {
+    char* end;
+    long long parsed = strtoll(value, &end, 10);
+    if (end == value || *end != '\0' || parsed < min) return false;
+    *out = parsed;
+    return true;
+}
+
+
+// Parses an on/off switch
+static bool parse_switch(const char* value, bool* out) {
+    if (strcmp(value, "on") == 0 || strcmp(value, "1") == 0) {
+        *out = true;
+    } else if (strcmp(value, "off") == 0 || strcmp(value, "0") == 0) {
+        *out = false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+
+static bool parse_threads(const char* value) {
+    return parse_int(value, 1, &sort_config.num_threads);
+}
+
+
+static bool parse_engine(const char* value) {
+    if (strcmp(value, "bitonic") == 0) {
+        sort_config.engine = ENGINE_BITONIC;
+    } else if (strcmp(value, "sample") == 0) {
+        sort_config.engine = ENGINE_SAMPLE;
+    } else if (strcmp(value, "auto") == 0) {
+        sort_config.engine = ENGINE_AUTO;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+
+static bool parse_exchange(const char* value) {
+    if (strcmp(value, "full") == 0) {
+        sort_config.exchange_mode = EXCHANGE_FULL;
+    } else if (strcmp(value, "split") == 0) {
+        sort_config.exchange_mode = EXCHANGE_SPLIT;
+    } else if (strcmp(value, "stream") == 0) {
+        sort_config.exchange_mode = EXCHANGE_STREAM;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+
+// Parses a positive byte count with an optional K, M or G suffix
+static bool parse_bytes(const char* value, long long* out) {
+    char* end;
+    long long parsed = strtoll(value, &end, 10);
+    if (end == value || parsed < 1) return false;
+    int shift = 0;
+    if (*end == 'K' || *end == 'k') shift = 10;
+    if (*end == 'M' || *end == 'm') shift = 20;
+    if (*end == 'G' || *end == 'g') shift = 30;
+    if (shift > 0) end++;
+    if (*end != '\0' || parsed > (1LL << 40) >> shift) return false;
+    *out = parsed << shift;
+    return true;
+}
+
+
+// Parses `auto` (0) or a byte count
+static bool parse_chunk(const char* value) {
+    if (strcmp(value, "auto") == 0) {
+        sort_config.chunk_bytes = 0;
+        return true;
+    }
+    return parse_bytes(value, &sort_config.chunk_bytes);
+}
+
+
+static bool parse_compress(const char* value) {
+    if (strcmp(value, "on") == 0) {
+        sort_config.compress = COMPRESS_ON;
+    } else if (strcmp(value, "off") == 0) {
+        sort_config.compress = COMPRESS_OFF;
+    } else if (strcmp(value, "auto") == 0) {
+        sort_config.compress = COMPRESS_AUTO;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+
+static bool parse_elements(const char* value) {
+    return parse_long(value, 1, &sort_config.total_elements);
+}
+
+
+static bool parse_dist(const char* value) {
+    for (int d = 0; d < INPUT_NUM_DISTS; d++) {
+        if (strcmp(value, input_dist_names[d]) == 0) {
+            sort_config.input_dist = (input_dist_t)d;
+            return true;
+        }
+    }
+    return false;
+}
+
+
+static bool parse_seed(const char* value) {
+    return parse_long(value, 0, &sort_config.seed);
+}
+
+
+static bool parse_input(const char* value) {
+    if (value[0] == '\0') return false;
+    sort_config.input_path = value;
+    return true;
+}
+
+
+static bool parse_output(const char* value) {
+    if (value[0] == '\0') return false;
+    sort_config.output_path = value;
+    return true;
+}
+
+
+static bool parse_io_overlap(const char* value) {
+    return parse_switch(value, &sort_config.io_overlap);
+}
+
+
+// Parses `off` (0, rows sorted in memory) or the byte budget of the external sort
+static bool parse_memory(const char* value) {
+    if (strcmp(value, "off") == 0) {
+        sort_config.memory_budget = 0;
+        return true;
+    }
+    return parse_bytes(value, &sort_config.memory_budget);
+}
+
+
+static bool parse_scratch(const char* value) {
+    if (value[0] == '\0') return false;
+    sort_config.scratch_dir = value;
+    return true;
+}
+
+
+static bool parse_shm(const char* value) {
+    return parse_switch(value, &sort_config.use_shared_memory);
+}
+
+
+static bool parse_remap(const char* value) {
+    return parse_switch(value, &sort_config.remap_ranks);
+}
+
+
+static bool parse_partitioned(const char* value) {
+    return parse_switch(value, &sort_config.partitioned);
+}
+
+
+// Output prefix of the trace files (`off` disables the trace)
+static bool parse_trace(const char* value) {
+    if (value[0] == '\0') return false;
+    sort_config.trace_prefix = (strcmp(value, "off") == 0) ? NULL : value;
+    return true;
+}
+
+
+static bool parse_trace_counters(const char* value) {
+    return parse_switch(value, &sort_config.trace_counters);
+}
+
+
+static bool parse_hugepages(const char* value) {
+    if (strcmp(value, "thp") == 0) {
+        sort_config.hugepages = HUGEPAGES_THP;
+    } else if (strcmp(value, "explicit") == 0) {
+        sort_config.hugepages = HUGEPAGES_EXPLICIT;
+    } else if (strcmp(value, "off") == 0) {
+        sort_config.hugepages = HUGEPAGES_OFF;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+
+// Table of every runtime setting: command line name, environment variable, parser and help text
+typedef struct {
+    const char* name;
+    const char* env;
+    bool (*parse)(const char* value);
+    const char* help;
+} config_option_t;
+
+static const config_option_t config_options[] = {
+    { "threads",        "BITONIC_THREADS",        parse_threads,        "<n>  threads per process (default 1)" },
+    { "engine",         "BITONIC_ENGINE",         parse_engine,         "<bitonic|sample|auto>  distributed sort algorithm, auto picks it from a cost model (default auto)" },
+    { "exchange",       "BITONIC_EXCHANGE",       parse_exchange,       "<full|split|stream>  whole-row exchange, compare-split of sorted rows, or whole-row exchange within about one row of memory (default full)" },
+    { "chunk",          "BITONIC_CHUNK",          parse_chunk,          "<bytes[K|M|G]|auto>  chunk size of the whole-row exchanges, auto calibrates it per step (default auto)" },
+    { "compress",       "BITONIC_COMPRESS",       parse_compress,       "<on|off|auto>  send the chunks of the whole-row exchanges delta bit-packed, auto on the links slower than the codec (default auto)" },
+    { "partitioned",    "BITONIC_PARTITIONED",    parse_partitioned,    "<on|off>  send the chunks through MPI-4 partitioned requests (default off)" },
+    { "shm",            "BITONIC_SHM",            parse_shm,            "<on|off>  exchange in place through shared memory with partners on the same node (default on)" },
+    { "remap",          "BITONIC_REMAP",          parse_remap,          "<on|off>  renumber the processes so that frequent partners share a socket/node (default on)" },
+    { "trace",          "BITONIC_TRACE",          parse_trace,          "<prefix|off>  record every stage/step of every process into <prefix>.csv, .json and .trace.json (default off)" },
+    { "trace-counters", "BITONIC_TRACE_COUNTERS", parse_trace_counters, "<on|off>  add hardware counters (perf_event_open) to the trace (default off)" },
+    { "hugepages",      "BITONIC_HUGEPAGES",      parse_hugepages,      "<thp|explicit|off>  back the row buffers with transparent or hugetlb huge pages (default thp)" },
+    { "elements",       "BITONIC_ELEMENTS",       parse_elements,       "<N>  sort N elements in total over any number of processes (replaces <q> <p>)" },
+    { "dist",           "BITONIC_DIST",           parse_dist,           "<uniform|sorted|reversed|nearly-sorted|zipf|equal|organ-pipe>  distribution of the generated keys (default uniform)" },
+    { "seed",           "BITONIC_SEED",           parse_seed,           "<n>  seed of the input generator, the input only depends on it and on N (default 1)" },
+    { "input",          "BITONIC_INPUT",          parse_input,          "<file>  sort the raw binary keys of a file, read with MPI-IO (replaces <q> <p> and the generator)" },
+    { "output",         "BITONIC_OUTPUT",         parse_output,         "<file>  write the sorted elements to a file with MPI-IO (default none)" },
+    { "io-overlap",     "BITONIC_IO_OVERLAP",     parse_io_overlap,     "<on|off>  sort the blocks of --input while the next ones are read, then merge them (default off)" },
+    { "memory",         "BITONIC_MEMORY",         parse_memory,         "<bytes[K|M|G]|off>  external sort through scratch files within this buffer budget per process (default off)" },
+    { "scratch",        "BITONIC_SCRATCH",        parse_scratch,        "<dir>  directory of the scratch files of --memory, local to each node (default $TMPDIR or /tmp)" },
+};
+
+#define NUM_CONFIG_OPTIONS (int)(sizeof(config_options) / sizeof(config_options[0]))
+
+
+// Loads the runtime settings from the environment and the command line
+bool config_init(int* argc, char* argv[], int rank) {
+    bool valid = true;
+
+    // Step 1: Environment variables
+    for (int o = 0; o < NUM_CONFIG_OPTIONS; o++) {
+        const char* value = getenv(config_options[o].env);
+        if (value && !config_options[o].parse(value)) {
+            if (rank == 0) fprintf(stderr, "Invalid value '%s' for %s\n", value, config_options[o].env);
+            valid = false;
+        }
+    }
+
+    // Step 2: Command line options (`--name value` or `--name=value`), positional arguments are kept
+    int kept = 1;
+    for (int i = 1; i < *argc; i++) {
+        if (strncmp(argv[i], "--", 2) != 0) {
+            argv[kept++] = argv[i];
+            continue;
+        }
+
+        const char* name = argv[i] + 2;
+        const char* eq = strchr(name, '=');
+        size_t name_len = eq ? (size_t)(eq - name) : strlen(name);
+
+        int o = 0;
+        while (o < NUM_CONFIG_OPTIONS &&
+               (strlen(config_options[o].name) != name_len || strncmp(config_options[o].name, name, name_len) != 0)) {
+            o++;
+        }
+        if (o == NUM_CONFIG_OPTIONS) {
+            if (rank == 0) fprintf(stderr, "Unknown option '%s'\n", argv[i]);
+            valid = false;
+            continue;
+        }
+
+        const char* value = eq ? eq + 1 : (i + 1 < *argc ? argv[++i] : NULL);
+        if (!value || !config_options[o].parse(value)) {
+            if (rank == 0) fprintf(stderr, "Invalid value for --%s\n", config_options[o].name);
+            valid = false;
+        }
+    }
+    *argc = kept;
+    argv[kept] = NULL;
+
+    return valid;
+}
+
+
+void config_print_usage(const char* prog) {
+    printf("Usage: %s <q: 2^q numbers/process> <p: 2^p processes> [options]\n", prog);
+    printf("       %s --elements <N> [options]\n", prog);
+    printf("Options (each one can also be set through its environment variable):\n");
+    for (int o = 0; o < NUM_CONFIG_OPTIONS; o++) {
+        printf("  --%s %s [%s]\n", config_options[o].name, config_options[o].help, config_options[o].env);
+    }
+}
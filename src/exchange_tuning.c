@@ -0,0 +1,172 @@
+#include "../inc/exchange_tuning.h"
+
+
+double exchange_probe(char* send, char* recv, int bytes, int partner, MPI_Comm comm) {
+    double best = DBL_MAX;
+    for (int i = 0; i < TUNING_REPEATS; i++) {
+        double start_time = MPI_Wtime();
+        MPI_Sendrecv(send, bytes, MPI_BYTE, partner, 0, recv, bytes, MPI_BYTE, partner, 0, comm, MPI_STATUS_IGNORE);
+        double elapsed = MPI_Wtime() - start_time;
+        if (elapsed < best) best = elapsed;
+    }
+    return best;
+}
+
+
+// Most chunks an exchange may use: the chunk index has to fit in the tag above stage/step
+// (the bound is only attached to `MPI_COMM_WORLD`, split communicators do not carry it)
+static int max_chunks(void) {
+    int* tag_ub;
+    int found;
+    MPI_Comm_get_attr(MPI_COMM_WORLD, MPI_TAG_UB, &tag_ub, &found);
+    int limit = found ? (*tag_ub >> 16) + 1 : 1;
+    return (limit < MAX_CHUNKS) ? limit : MAX_CHUNKS;
+}
+
+
+// Fastest compare-exchange of two interleaved rows, in seconds per element
+static double probe_compare(int rank, MPI_Comm comm) {
+    elem_t* rows = calloc(2 * COMPARE_PROBE, sizeof(elem_t));
+    if (!rows) {
+        fprintf(stderr, "Rank %d: Memory allocation failed\n", rank);
+        MPI_Abort(comm, -1);
+    }
+    for (int i = 0; i < COMPARE_PROBE; i++) {
+        KEY(rows[i]) = (sort_key_t)((i & 1) ? 2 * i : 2 * i + 1);
+        KEY(rows[COMPARE_PROBE + i]) = (sort_key_t)(2 * i);
+    }
+
+    double best = DBL_MAX;
+    for (int i = 0; i < TUNING_REPEATS; i++) {
+        double start_time = MPI_Wtime();
+        pairwise_sort(rows, rows + COMPARE_PROBE, COMPARE_PROBE, (i & 1) == 0);
+        double elapsed = MPI_Wtime() - start_time;
+        if (elapsed < best) best = elapsed;
+    }
+    free(rows);
+    return best / COMPARE_PROBE;
+}
+
+
+void chunk_plan_create(chunk_plan_t* plan, int cols, int comm_threads, const shm_context_t* shm, MPI_Comm comm) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    memset(plan, 0, sizeof(*plan));
+    while ((1 << plan->steps) < size && plan->steps < MAX_EXCHANGE_STEPS) plan->steps++;
+    int limit = max_chunks();
+
+    // `--compress on`: every step between nodes, whether the steps on a node go through the window or not
+    for (int step = 0; step < plan->steps; step++) {
+        int partner = rank ^ (1 << step);
+        bool local = (partner >= size) || (shm && shm_same_node(shm, partner));
+        plan->max_ratio[step] = (sort_config.compress == COMPRESS_ON && !SORT_PAYLOAD && !local) ? 1.0 : 0.0;
+    }
+
+    // Fixed size (`--chunk`): no calibration
+    if (sort_config.chunk_bytes > 0) {
+        long long elements = sort_config.chunk_bytes / (long long)sizeof(elem_t);
+        if (elements < 1) elements = 1;
+        if (elements < (cols + limit - 1) / limit) elements = (cols + limit - 1) / limit;
+        for (int step = 0; step < plan->steps; step++) {
+            plan->chunk_elements[step] = (elements < cols) ? (int)elements : (cols > 0 ? cols : 1);
+        }
+        return;
+    }
+    plan->tuned = true;
+
+    // Step 1: Latency and bandwidth of the partner of every step (shared memory partners send no messages)
+    long long row_bytes = (long long)cols * sizeof(elem_t);
+    int probe_bytes = (row_bytes < TUNING_PROBE_BYTES) ? (int)row_bytes : TUNING_PROBE_BYTES;
+    char* send = calloc(probe_bytes > 0 ? probe_bytes : 1, 1);
+    char* recv = malloc(probe_bytes > 0 ? probe_bytes : 1);
+    if (!send || !recv) {
+        fprintf(stderr, "Rank %d: Memory allocation failed\n", rank);
+        MPI_Abort(comm, -1);
+    }
+
+    for (int step = 0; step < plan->steps; step++) {
+        int partner = rank ^ (1 << step);
+        plan->latency[step] = 0.0;
+        plan->bandwidth[step] = DBL_MAX;
+        if (partner >= size || (shm && shm_is_local(shm, partner))) continue;
+
+        plan->latency[step] = exchange_probe(send, recv, 0, partner, comm);
+        double transfer = exchange_probe(send, recv, probe_bytes, partner, comm) - plan->latency[step];
+        plan->bandwidth[step] = probe_bytes / (transfer > 0.0 ? transfer : 1e-9);
+    }
+    free(send);
+    free(recv);
+
+    // Step 2: Speed of the compare-exchange that consumes the chunks
+    plan->compare_time = probe_compare(rank, comm);
+
+    // The slowest pair of every step and the slowest process set the pace (and every pair agrees on the sizes)
+    MPI_Allreduce(MPI_IN_PLACE, plan->latency, plan->steps, MPI_DOUBLE, MPI_MAX, comm);
+    MPI_Allreduce(MPI_IN_PLACE, plan->bandwidth, plan->steps, MPI_DOUBLE, MPI_MIN, comm);
+    MPI_Allreduce(MPI_IN_PLACE, &plan->compare_time, 1, MPI_DOUBLE, MPI_MAX, comm);
+
+    // Compression pays on the links slower than the codec (bare keys only, see `wire_codec.h`)
+    if (sort_config.compress == COMPRESS_AUTO && !SORT_PAYLOAD) {
+        plan->codec_speed = wire_codec_speed();
+        MPI_Allreduce(MPI_IN_PLACE, &plan->codec_speed, 1, MPI_DOUBLE, MPI_MIN, comm);
+        for (int step = 0; step < plan->steps; step++) {
+            double saving = (plan->latency[step] > 0.0) ? 1.0 - plan->bandwidth[step] / plan->codec_speed : 0.0;
+            plan->max_ratio[step] = (saving >= WIRE_MIN_SAVING) ? saving : 0.0;
+        }
+    }
+
+    // Step 3: Chunk count of every step, then rounded to whole cache lines
+    int line = (sizeof(elem_t) < 64) ? (int)(64 / sizeof(elem_t)) : 1;
+    for (int step = 0; step < plan->steps; step++) {
+        double chunks = 1.0;
+        if (plan->latency[step] > 0.0) {
+            double transfer = row_bytes / plan->bandwidth[step];
+            double compare = cols * plan->compare_time / comm_threads;
+            chunks = sqrt(((transfer < compare) ? transfer : compare) / plan->latency[step]);
+            if (chunks > (double)row_bytes / MIN_CHUNK_BYTES) chunks = (double)row_bytes / MIN_CHUNK_BYTES;
+        }
+        if (chunks < comm_threads) chunks = comm_threads;
+        if (chunks > limit) chunks = limit;
+        if (chunks < 1.0) chunks = 1.0;
+
+        int count = (int)chunks;
+        int elements = (cols + count - 1) / count;
+        elements = (elements + line - 1) / line * line;
+        if (elements < (cols + limit - 1) / limit) elements = (cols + limit - 1) / limit;
+        plan->chunk_elements[step] = (elements < cols) ? elements : (cols > 0 ? cols : 1);
+    }
+}
+
+
+void chunk_plan_report(const chunk_plan_t* plan, int cols, int rank) {
+    if (rank != 0 || plan->steps == 0) return;
+
+    if (!plan->tuned) {
+        int count = (cols + plan->chunk_elements[0] - 1) / plan->chunk_elements[0];
+        bool compressed = false;
+        for (int step = 0; step < plan->steps; step++) compressed |= (plan->max_ratio[step] > 0.0);
+        printf("Exchange chunks (--chunk): %d x %.1f KiB per row at every step%s\n",
+               count, plan->chunk_elements[0] * sizeof(elem_t) / 1024.0, compressed ? ", compressed between nodes" : "");
+        fflush(stdout);
+        return;
+    }
+
+    printf("Exchange chunks (calibrated, compare %.2f ns/element", plan->compare_time * 1e9);
+    if (plan->codec_speed > 0.0) printf(", codec %.2f GB/s", plan->codec_speed / 1e9);
+    printf("):\n");
+    for (int step = 0; step < plan->steps; step++) {
+        int count = (cols + plan->chunk_elements[step] - 1) / plan->chunk_elements[step];
+        if (plan->latency[step] > 0.0) {
+            printf("  step %2d (partner distance %d): %d x %.1f KiB (latency %.2f us, bandwidth %.2f GB/s)",
+                   step, 1 << step, count, plan->chunk_elements[step] * sizeof(elem_t) / 1024.0,
+                   plan->latency[step] * 1e6, plan->bandwidth[step] / 1e9);
+            if (plan->max_ratio[step] > 0.0) printf(", compressed below %.0f%%", plan->max_ratio[step] * 100);
+            printf("\n");
+        } else {
+            printf("  step %2d (partner distance %d): shared memory\n", step, 1 << step);
+        }
+    }
+    fflush(stdout);
+}
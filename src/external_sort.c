@@ -0,0 +1,505 @@
+#include "../inc/external_sort.h"
+
+
+// Scratch file of this process, deleted when closed
+typedef struct {
+    MPI_File file;
+    MPI_Comm comm;          // Communicator aborted on I/O errors
+    char path[4096];
+} scratch_t;
+
+
+// Sequential reader of a range of a scratch file, double buffered: the next block is in flight
+// (nonblocking read) while the current one is consumed
+typedef struct {
+    scratch_t* scratch;
+    elem_t* buffers[2];
+    int block;              // Elements per buffer
+    long long next, end;    // Next element to request and end of the range
+    int lens[2];            // Elements held by each buffer
+    int current, pos;       // Buffer being consumed and position in it
+    MPI_Request request;    // Read into the other buffer
+} stream_reader_t;
+
+
+// Sequential writer to a scratch file, double buffered: a full block is written (nonblocking write)
+// while the other one fills
+typedef struct {
+    scratch_t* scratch;
+    elem_t* buffers[2];
+    int block;
+    int fill, current;
+    long long position;         // Where the current buffer goes in the file
+    MPI_Request requests[2];    // Write in flight from each buffer
+} stream_writer_t;
+
+
+// Current key of a run in the k-way merge
+typedef struct {
+    sort_key_t key;
+    int run;
+} heap_entry_t;
+
+
+static MPI_Offset elem_offset(long long position) {
+    return (MPI_Offset)position * (MPI_Offset)sizeof(elem_t);
+}
+
+
+static long long min_ll(long long a, long long b) {
+    return a < b ? a : b;
+}
+
+
+static void scratch_open(scratch_t* scratch, const char* dir, int job, const char* name, MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    scratch->comm = comm;
+    snprintf(scratch->path, sizeof(scratch->path), "%s/bitonic_%d_%d.%s", dir, job, rank, name);
+    file_io_check(MPI_File_open(MPI_COMM_SELF, scratch->path, MPI_MODE_CREATE | MPI_MODE_RDWR | MPI_MODE_DELETE_ON_CLOSE,
+                                MPI_INFO_NULL, &scratch->file), "Opening", scratch->path, comm);
+}
+
+
+static void swap_scratch(scratch_t** a, scratch_t** b) {
+    scratch_t* temp = *a;
+    *a = *b;
+    *b = temp;
+}
+
+
+// Probed key of a row on scratch (see `compare_split_cut`)
+static sort_key_t scratch_key(const void* row, int position) {
+    const scratch_t* scratch = row;
+    elem_t e;
+    file_io_check(MPI_File_read_at(scratch->file, elem_offset(position), &e, 1, elem_mpi_type(), MPI_STATUS_IGNORE),
+                  "Reading", scratch->path, scratch->comm);
+    return KEY(e);
+}
+
+
+// Starts the read of the next block of the range into buffer `b` (nothing past the end)
+static void reader_request(stream_reader_t* r, int b) {
+    r->lens[b] = (int)min_ll(r->block, r->end - r->next);
+    if (r->lens[b] == 0) return;
+    file_io_check(MPI_File_iread_at(r->scratch->file, elem_offset(r->next), r->buffers[b], r->lens[b], elem_mpi_type(), &r->request),
+                  "Reading", r->scratch->path, r->scratch->comm);
+    r->next += r->lens[b];
+}
+
+
+// Reads the elements [begin, end) of a scratch file through two buffers of `block` elements at `buffers`
+static void reader_open(stream_reader_t* r, scratch_t* scratch, long long begin, long long end, elem_t* buffers, int block) {
+    r->scratch = scratch;
+    r->buffers[0] = buffers;
+    r->buffers[1] = buffers + block;
+    r->block = block;
+    r->next = begin;
+    r->end = end;
+    r->request = MPI_REQUEST_NULL;
+
+    reader_request(r, 0);
+    MPI_Wait(&r->request, MPI_STATUS_IGNORE);
+    r->current = 0;
+    r->pos = 0;
+    reader_request(r, 1);
+}
+
+
+// Current element, NULL at the end of the range. Once a block is consumed, the prefetched one takes
+// its place and the read of the following block starts
+static inline const elem_t* reader_peek(stream_reader_t* r) {
+    if (r->pos < r->lens[r->current]) return &r->buffers[r->current][r->pos];
+
+    int other = r->current ^ 1;
+    if (r->lens[other] == 0) return NULL;
+    MPI_Wait(&r->request, MPI_STATUS_IGNORE);
+    reader_request(r, r->current);
+    r->current = other;
+    r->pos = 0;
+    return r->buffers[other];
+}
+
+
+// Elements left in the current block (after `reader_peek`)
+static inline int reader_available(const stream_reader_t* r) {
+    return r->lens[r->current] - r->pos;
+}
+
+
+// Writes elements from `position` of a scratch file through two buffers of `block` elements at `buffers`
+static void writer_open(stream_writer_t* w, scratch_t* scratch, long long position, elem_t* buffers, int block) {
+    w->scratch = scratch;
+    w->buffers[0] = buffers;
+    w->buffers[1] = buffers + block;
+    w->block = block;
+    w->fill = 0;
+    w->current = 0;
+    w->position = position;
+    w->requests[0] = w->requests[1] = MPI_REQUEST_NULL;
+}
+
+
+// Starts the write of the current buffer and switches to the other one, once its own write is done
+static void writer_flush(stream_writer_t* w) {
+    if (w->fill == 0) return;
+    file_io_check(MPI_File_iwrite_at(w->scratch->file, elem_offset(w->position), w->buffers[w->current], w->fill, elem_mpi_type(),
+                                     &w->requests[w->current]), "Writing", w->scratch->path, w->scratch->comm);
+    w->position += w->fill;
+    w->fill = 0;
+    w->current ^= 1;
+    MPI_Wait(&w->requests[w->current], MPI_STATUS_IGNORE);
+}
+
+
+static inline void writer_push(stream_writer_t* w, const elem_t* e) {
+    w->buffers[w->current][w->fill++] = *e;
+    if (w->fill == w->block) writer_flush(w);
+}
+
+
+// Free buffer of `block` elements (the writer is flushed), filled directly by the caller then committed
+static inline elem_t* writer_slot(stream_writer_t* w) {
+    return w->buffers[w->current];
+}
+
+
+static inline void writer_commit(stream_writer_t* w, int len) {
+    w->fill = len;
+    writer_flush(w);
+}
+
+
+// Flushes the last elements and waits for every write. Returns the end position
+static long long writer_close(stream_writer_t* w) {
+    writer_flush(w);
+    MPI_Waitall(2, w->requests, MPI_STATUSES_IGNORE);
+    return w->position;
+}
+
+
+static void sift_down(heap_entry_t* heap, int size, int i) {
+    heap_entry_t top = heap[i];
+    for (;;) {
+        int child = 2 * i + 1;
+        if (child >= size) break;
+        if (child + 1 < size && heap[child + 1].key < heap[child].key) child++;
+        if (!(heap[child].key < top.key)) break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = top;
+}
+
+
+// Merges k ascending streams into the writer through a min-heap of their current keys
+static void merge_streams(stream_reader_t* readers, int k, stream_writer_t* writer) {
+    heap_entry_t heap[EXTERNAL_MAX_FAN_IN];
+    int size = 0;
+    for (int i = 0; i < k; i++) {
+        const elem_t* head = reader_peek(&readers[i]);
+        if (head) heap[size++] = (heap_entry_t){ KEY(*head), i };
+    }
+    for (int i = size / 2 - 1; i >= 0; i--) sift_down(heap, size, i);
+
+    while (size > 0) {
+        stream_reader_t* r = &readers[heap[0].run];
+        writer_push(writer, &r->buffers[r->current][r->pos]);
+        r->pos++;
+        const elem_t* head = reader_peek(r);
+        if (head) {
+            heap[0].key = KEY(*head);
+        } else {
+            heap[0] = heap[--size];
+        }
+        if (size > 0) sift_down(heap, size, 0);
+    }
+}
+
+
+// Phase 1: sorted runs of up to `chunk` elements, spilled one after the other to `runs`. The piece is
+// sorted in the first `chunk` elements of `chunk_buffer`, with the next `chunk` ones as its scratch.
+// `bounds` receives the start of every run and the end of the last one, `input` the fingerprint of the pieces
+static void build_runs(scratch_t* runs, long long* bounds, int local_runs, elem_t* chunk_buffer, int chunk,
+                       long long total, int count, long long first, fingerprint_t* input, MPI_Comm comm) {
+    // Reading the input is collective: every process takes part in every piece, possibly with nothing
+    int max_runs;
+    MPI_Allreduce(&local_runs, &max_runs, 1, MPI_INT, MPI_MAX, comm);
+
+    bounds[0] = 0;
+    for (int r = 0; r < max_runs; r++) {
+        long long lo = (long long)r * chunk;
+        int len = (r < local_runs) ? (int)min_ll(chunk, count - lo) : 0;
+
+        if (sort_config.input_path) {
+            // The blocks of the piece are sorted while the next ones are read, then merged
+            file_io_read(sort_config.input_path, chunk_buffer, len, first + lo, true, chunk_buffer + chunk, comm);
+        } else {
+            generate_input(chunk_buffer, len, first + lo, total, sort_config.input_dist, sort_config.seed, sort_config.num_threads);
+            parallel_local_sort_buffered(chunk_buffer, chunk_buffer + chunk, len, true, sort_config.num_threads);
+        }
+        fingerprint_add(input, chunk_buffer, len);
+
+        if (r < local_runs) {
+            file_io_check(MPI_File_write_at(runs->file, elem_offset(lo), chunk_buffer, len, elem_mpi_type(), MPI_STATUS_IGNORE),
+                          "Writing", runs->path, comm);
+            bounds[r + 1] = lo + len;
+        }
+    }
+}
+
+
+// Phase 2: passes of k-way merges from `*row` to `*spare` (which then swap) until a single run is
+// left in `*row`. Every merged run takes the place of its inputs in the file
+static void merge_run_files(scratch_t** row, scratch_t** spare, long long* bounds, int runs, elem_t* arena, long long budget_elems) {
+    // Every input run and the output get two blocks, of at least EXTERNAL_MIN_BLOCK bytes if the budget allows
+    long long fan_in = budget_elems * (long long)sizeof(elem_t) / (2 * EXTERNAL_MIN_BLOCK) - 1;
+    if (fan_in > EXTERNAL_MAX_FAN_IN) fan_in = EXTERNAL_MAX_FAN_IN;
+    if (fan_in < 2) fan_in = 2;
+
+    stream_reader_t readers[EXTERNAL_MAX_FAN_IN];
+    stream_writer_t writer;
+    while (runs > 1) {
+        int k_max = (int)min_ll(fan_in, runs);
+        int block = (int)min_ll(budget_elems / (2 * (k_max + 1)), INT_MAX / 2);
+
+        int merged = 0;
+        for (int g = 0; g < runs; g += k_max) {
+            int k = (int)min_ll(k_max, runs - g);
+            for (int i = 0; i < k; i++) {
+                reader_open(&readers[i], *row, bounds[g + i], bounds[g + i + 1], arena + 2LL * i * block, block);
+            }
+            writer_open(&writer, *spare, bounds[g], arena + 2LL * k * block, block);
+            merge_streams(readers, k, &writer);
+            writer_close(&writer);
+            bounds[merged++] = bounds[g];  // The groups before this one are already merged: no bound is overwritten early
+        }
+        bounds[merged] = bounds[runs];
+        runs = merged;
+        swap_scratch(row, spare);
+    }
+}
+
+
+// Phase 3 step: compare-split of a row on scratch (the same cut and the same kept parts as `compare_split`).
+// The crossing elements are streamed to the partner block by block while the ones it sends land in
+// `incoming`, then the kept part of the row is merged with them into `*spare` (which becomes the row).
+// Returns the new number of elements of the row
+static int external_compare_split(scratch_t** row, scratch_t** spare, scratch_t* incoming, elem_t* arena, int block,
+                                  int capacity, int n, int partner, bool keep_low, int tag, MPI_Comm comm) {
+    int cut = compare_split_cut(scratch_key, *row, capacity, n, partner, keep_low, tag, comm);
+    if (cut == 0) return n;  // The ranges do not overlap: nothing crosses
+
+    int send_first, send_count, kept_first, kept_end;
+    if (keep_low) {
+        send_first = capacity - cut;
+        send_count = (n > send_first) ? n - send_first : 0;
+        kept_first = 0;
+        kept_end = (n < capacity - cut) ? n : capacity - cut;
+    } else {
+        send_first = 0;
+        send_count = (n < cut) ? n : cut;
+        kept_first = send_count;
+        kept_end = n;
+    }
+
+    int recv_count;
+    MPI_Sendrecv(&send_count, 1, MPI_INT, partner, tag, &recv_count, 1, MPI_INT, partner, tag, comm, MPI_STATUS_IGNORE);
+
+    // Exchange: every block read from the row is sent while a block of the partner is received
+    // straight into the free buffer of the writer
+    stream_reader_t reader;
+    stream_writer_t writer;
+    reader_open(&reader, *row, send_first, send_first + send_count, arena, block);
+    writer_open(&writer, incoming, 0, arena + 2LL * block, block);
+    int sent = 0, received = 0;
+    trace_wait_begin();
+    while (sent < send_count || received < recv_count) {
+        MPI_Request requests[2] = { MPI_REQUEST_NULL, MPI_REQUEST_NULL };
+        MPI_Status statuses[2];
+        int len = 0;
+        if (sent < send_count) {
+            const elem_t* data = reader_peek(&reader);
+            len = reader_available(&reader);
+            MPI_Isend(data, len, elem_mpi_type(), partner, tag, comm, &requests[0]);
+        }
+        if (received < recv_count) {
+            MPI_Irecv(writer_slot(&writer), block, elem_mpi_type(), partner, tag, comm, &requests[1]);
+        }
+        bool receiving = (received < recv_count);
+        MPI_Waitall(2, requests, statuses);
+
+        reader.pos += len;
+        sent += len;
+        if (receiving) {
+            int got;
+            MPI_Get_count(&statuses[1], elem_mpi_type(), &got);
+            writer_commit(&writer, got);
+            received += got;
+        }
+    }
+    writer_close(&writer);
+    trace_wait_end();
+    trace_bytes((long long)send_count * sizeof(elem_t), (long long)recv_count * sizeof(elem_t));
+
+    // Merge of the kept part with the received elements, both ascending
+    stream_reader_t streams[2];
+    reader_open(&streams[0], *row, kept_first, kept_end, arena, block);
+    reader_open(&streams[1], incoming, 0, recv_count, arena + 2LL * block, block);
+    writer_open(&writer, *spare, 0, arena + 4LL * block, block);
+    merge_streams(streams, 2, &writer);
+    int count = (int)writer_close(&writer);
+    swap_scratch(row, spare);
+    return count;
+}
+
+
+// Phase 4: streams the final row once to check it (see `validate_scanned`) and to write it at its
+// place in `--output` (if set). Returns true on every process if the sort is correct
+static bool finish_rows(scratch_t* row, int n, const fingerprint_t* input, elem_t* arena, long long budget_elems, MPI_Comm comm) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    int block = (int)min_ll(budget_elems / 2, INT_MAX / 2);
+
+    // The rows follow each other in rank order
+    long long local = n, offset = 0;
+    MPI_Exscan(&local, &offset, 1, MPI_LONG_LONG, MPI_SUM, comm);
+    if (rank == 0) offset = 0;
+
+    MPI_File output = MPI_FILE_NULL;
+    if (sort_config.output_path) {
+        file_io_check(MPI_File_open(comm, sort_config.output_path, MPI_MODE_WRONLY | MPI_MODE_CREATE, MPI_INFO_NULL, &output),
+                      "Opening", sort_config.output_path, comm);
+        file_io_check(MPI_File_set_size(output, 0), "Truncating", sort_config.output_path, comm);
+    }
+
+    // Every process takes part in every collective write, with an empty block past its row
+    int local_blocks = (n + block - 1) / block, blocks;
+    MPI_Allreduce(&local_blocks, &blocks, 1, MPI_INT, MPI_MAX, comm);
+
+    fingerprint_t result = { 0, 0, 0, 0, 0 };
+    sort_key_t first = 0, last = 0;
+    stream_reader_t reader;
+    reader_open(&reader, row, 0, n, arena, block);
+    for (int b = 0; b < blocks; b++) {
+        const elem_t* data = reader_peek(&reader);
+        int len = data ? reader_available(&reader) : 0;
+        if (len > 0) {
+            if (b == 0) first = KEY(data[0]);
+            if (b > 0 && KEY(data[0]) < last) result.disorder++;
+            result.disorder += count_descents(data, len);
+            fingerprint_add(&result, data, len);
+            last = KEY(data[len - 1]);
+        }
+
+        if (output != MPI_FILE_NULL) {
+            file_io_check(MPI_File_write_at_all(output, elem_offset(offset), data ? data : arena, len, elem_mpi_type(), MPI_STATUS_IGNORE),
+                          "Writing", sort_config.output_path, comm);
+        }
+        offset += len;
+        reader.pos += len;
+    }
+    if (output != MPI_FILE_NULL) MPI_File_close(&output);
+
+    return validate_scanned(first, last, n, &result, input, comm);
+}
+
+
+bool external_sort(long long total, int capacity, int count, long long first, MPI_Comm comm) {
+    int rank, rows;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &rows);
+
+    // Every buffer of every phase is carved from the budget
+    long long budget_elems = sort_config.memory_budget / (long long)sizeof(elem_t);
+    if (budget_elems < 2 * EXTERNAL_NET_BLOCKS) {
+        if (rank == 0) fprintf(stderr, "Rank %d: --memory %lld is too small for the blocks of the external sort\n", rank, sort_config.memory_budget);
+        MPI_Abort(comm, -1);
+    }
+    elem_t* arena = (elem_t*)arena_map((size_t)budget_elems * sizeof(elem_t));
+    int chunk = (int)min_ll(budget_elems / 2, count > 0 ? count : 1);  // Half of the budget is left to the sort of a piece
+    int local_runs = (count + chunk - 1) / chunk;
+    long long* bounds = malloc((local_runs + 1) * sizeof(long long));
+    if (!arena || !bounds) {
+        fprintf(stderr, "Rank %d: Memory allocation failed\n", rank);
+        MPI_Abort(comm, -1);
+    }
+
+    // Scratch files, named after the job (pid of rank 0) and the rank
+    const char* dir = sort_config.scratch_dir ? sort_config.scratch_dir : getenv("TMPDIR");
+    if (!dir || dir[0] == '\0') dir = "/tmp";
+    int job = (int)getpid();
+    MPI_Bcast(&job, 1, MPI_INT, 0, comm);
+    scratch_t files[3];
+    scratch_t* row = &files[0];
+    scratch_t* spare = &files[1];
+    scratch_t* incoming = &files[2];
+    scratch_open(row, dir, job, "row", comm);
+    scratch_open(spare, dir, job, "spare", comm);
+    scratch_open(incoming, dir, job, "incoming", comm);
+
+    MPI_Barrier(comm);
+    double times[5];
+    times[0] = MPI_Wtime();
+
+    // Phase 1: sorted runs
+    trace_begin(TRACE_LOCAL_SORT, -1, -1, -1);
+    fingerprint_t input = { 0, 0, 0, 0, 0 };
+    build_runs(row, bounds, local_runs, arena, chunk, total, count, first, &input, comm);
+    trace_end();
+    fingerprint_reduce(&input, comm);
+    times[1] = MPI_Wtime();
+
+    // Phase 2: a single sorted row
+    trace_begin(TRACE_MERGE, -1, -1, -1);
+    merge_run_files(&row, &spare, bounds, local_runs, arena, budget_elems);
+    trace_end();
+    times[2] = MPI_Wtime();
+
+    // Phase 3: the compare-split network of `bitonic_sort_split`, in its flip form
+    int block = (int)min_ll(budget_elems / EXTERNAL_NET_BLOCKS, INT_MAX / 2);
+    int stages = 0;
+    while ((1 << stages) < rows) stages++;
+    int n = count;
+    for (int stage = 1; stage <= stages; stage++) {
+        for (int step = stage - 1; step >= 0; step--) {
+            int partner = bitonic_partner(rank, stage, step, true);
+            if (rank != partner && partner < rows) {
+                trace_begin(TRACE_COMPARE_SPLIT, stage, step, partner);
+                n = external_compare_split(&row, &spare, incoming, arena, block, capacity, n, partner, rank < partner,
+                                           (stage << 8) | step, comm);
+                trace_end();
+            }
+        }
+    }
+    times[3] = MPI_Wtime();
+
+    // Phase 4: check and output
+    bool sorted = finish_rows(row, n, &input, arena, budget_elems, comm);
+    times[4] = MPI_Wtime();
+
+    // Report: the slowest process of every phase, and the largest resident set
+    double phases[5];
+    for (int p = 0; p < 4; p++) phases[p] = times[p + 1] - times[p];
+    phases[4] = times[4] - times[0];
+    MPI_Allreduce(MPI_IN_PLACE, phases, 5, MPI_DOUBLE, MPI_MAX, comm);
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    long peak_kb = usage.ru_maxrss;
+    MPI_Allreduce(MPI_IN_PLACE, &peak_kb, 1, MPI_LONG, MPI_MAX, comm);
+
+    if (rank == 0) {
+        printf("External sort: %.1f MB budget per process, %d runs of up to %d elements, %d-element blocks, scratch in %s\n",
+               sort_config.memory_budget / 1e6, local_runs, chunk, block, dir);
+        printf("Runs: %f sec, Merge: %f sec, Network: %f sec, Output: %f sec\n", phases[0], phases[1], phases[2], phases[3]);
+        printf("Sorting Time: %f msec\n", phases[4] * 1000);
+        printf("Peak RSS: %.1f MB (largest process)\n", peak_kb / 1024.0);
+        fflush(stdout);
+    }
+
+    // Clean up (closing deletes the scratch files)
+    for (int f = 0; f < 3; f++) MPI_File_close(&files[f].file);
+    free(bounds);
+    arena_unmap(arena, (size_t)budget_elems * sizeof(elem_t));
+    return sorted;
+}
@@ -0,0 +1,224 @@
+#include "../inc/file_io.h"
+
+
+// Files return their errors by default, so every I/O call goes through this check
+void file_io_check(int err, const char* what, const char* path, MPI_Comm comm) {
+    if (err == MPI_SUCCESS) return;
+
+    int rank, len;
+    char message[MPI_MAX_ERROR_STRING];
+    MPI_Comm_rank(comm, &rank);
+    MPI_Error_string(err, message, &len);
+    fprintf(stderr, "Rank %d: %s %s failed: %s\n", rank, what, path, message);
+    MPI_Abort(comm, -1);
+}
+
+
+// Hints for large aligned accesses: collective buffering with one block per aggregator round,
+// and file stripes of one block on the file systems that take them
+static MPI_Info io_info(void) {
+    char block[32];
+    snprintf(block, sizeof(block), "%d", IO_BLOCK_BYTES);
+
+    MPI_Info info;
+    MPI_Info_create(&info);
+    MPI_Info_set(info, "cb_buffer_size", block);
+    MPI_Info_set(info, "striping_unit", block);
+    MPI_Info_set(info, "romio_cb_read", "enable");
+    MPI_Info_set(info, "romio_cb_write", "enable");
+    return info;
+}
+
+
+static MPI_File open_file(const char* path, int mode, MPI_Comm comm) {
+    MPI_Info info = io_info();
+    MPI_File file;
+    file_io_check(MPI_File_open(comm, path, mode, info, &file), "Opening", path, comm);
+    MPI_Info_free(&info);
+    return file;
+}
+
+
+// Number of blocks of a slice of `count` items starting at item `first`
+static int count_blocks(long long first, int count, int item_bytes) {
+    if (count == 0) return 0;
+    long long begin = first * item_bytes, end = (first + count) * item_bytes;
+    return (int)((end - 1) / IO_BLOCK_BYTES - begin / IO_BLOCK_BYTES + 1);
+}
+
+
+// Items of block `b` of the slice: block boundaries are multiples of IO_BLOCK_BYTES in the file,
+// so only the first and last blocks of a slice are partial. Returns the length, 0 past the end
+static int block_range(long long first, int count, int item_bytes, int b, int* lo) {
+    long long begin = first * item_bytes, end = (first + count) * item_bytes;
+    long long block_begin = (begin / IO_BLOCK_BYTES + b) * IO_BLOCK_BYTES;
+    long long block_end = block_begin + IO_BLOCK_BYTES;
+    if (block_begin < begin) block_begin = begin;
+    if (block_end > end) block_end = end;
+
+    if (block_end <= block_begin) {
+        *lo = count;
+        return 0;
+    }
+    *lo = (int)((block_begin - begin) / item_bytes);
+    return (int)((block_end - block_begin) / item_bytes);
+}
+
+
+// Where the keys of a block land: straight in the row for bare keys, in a contiguous staging
+// buffer with a payload (a strided memory datatype is much slower for nonblocking reads)
+static void* block_target(elem_t* row, int lo, sort_key_t* stage) {
+#if SORT_PAYLOAD
+    (void)row;
+    (void)lo;
+    return stage;
+#else
+    (void)stage;
+    return row + lo;
+#endif
+}
+
+
+// Completes a block that arrived: with a payload, its keys move into the row with their position in the file as id
+static void unpack_block(elem_t* block, const sort_key_t* stage, int len, long long position) {
+#if SORT_PAYLOAD
+    for (int i = 0; i < len; i++) {
+        block[i].key = stage[i];
+        block[i].id = (sort_id_t)(position + i);
+    }
+#else
+    (void)block;
+    (void)stage;
+    (void)len;
+    (void)position;
+#endif
+}
+
+
+long long file_io_count(const char* path, MPI_Comm comm) {
+    MPI_File file = open_file(path, MPI_MODE_RDONLY, comm);
+    MPI_Offset bytes;
+    file_io_check(MPI_File_get_size(file, &bytes), "Reading the size of", path, comm);
+    MPI_File_close(&file);
+
+    if (bytes % (MPI_Offset)sizeof(sort_key_t) != 0) {
+        int rank;
+        MPI_Comm_rank(comm, &rank);
+        if (rank == 0) fprintf(stderr, "Rank %d: %s holds %lld bytes, not a whole number of %s keys\n", rank, path, (long long)bytes, KEY_NAME);
+        MPI_Abort(comm, -1);
+    }
+    return (long long)bytes / (long long)sizeof(sort_key_t);
+}
+
+
+double file_io_read(const char* path, elem_t* row, int count, long long first, bool presort, elem_t* scratch, MPI_Comm comm) {
+    const int key_bytes = (int)sizeof(sort_key_t);
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Barrier(comm);
+    double start = MPI_Wtime();
+
+    MPI_File file = open_file(path, MPI_MODE_RDONLY, comm);
+
+    // Every process takes part in every collective read, with an empty block past its slice
+    int local_blocks = count_blocks(first, count, key_bytes);
+    int blocks;
+    MPI_Allreduce(&local_blocks, &blocks, 1, MPI_INT, MPI_MAX, comm);
+
+    // Two staging buffers (payload only): one being read while the other one is unpacked
+    sort_key_t* stage[2] = { NULL, NULL };
+    int* bounds = malloc((size_t)(blocks + 1) * sizeof(int));
+    bool staged = (SORT_PAYLOAD != 0);
+    if (staged) {
+        stage[0] = malloc(IO_BLOCK_BYTES);
+        stage[1] = malloc(IO_BLOCK_BYTES);
+    }
+    if (!bounds || (staged && (!stage[0] || !stage[1]))) {
+        fprintf(stderr, "Rank %d: Memory allocation failed\n", rank);
+        MPI_Abort(comm, -1);
+    }
+
+    if (!presort) {
+        for (int b = 0; b < blocks; b++) {
+            int lo, len = block_range(first, count, key_bytes, b, &lo);
+            file_io_check(MPI_File_read_at_all(file, (first + lo) * key_bytes, block_target(row, lo, stage[0]), len, KEY_MPI_TYPE, MPI_STATUS_IGNORE),
+                     "Reading", path, comm);
+            unpack_block(row + lo, stage[0], len, first + lo);
+        }
+    } else {
+        // Pipeline: the next block is in flight while the one that arrived is sorted, then the
+        // sorted blocks are merged
+        MPI_Request request = MPI_REQUEST_NULL;
+        int lo, len = block_range(first, count, key_bytes, 0, &lo);
+        if (blocks > 0) {
+            file_io_check(MPI_File_iread_at_all(file, (first + lo) * key_bytes, block_target(row, lo, stage[0]), len, KEY_MPI_TYPE, &request),
+                     "Reading", path, comm);
+        }
+        for (int b = 0; b < blocks; b++) {
+            MPI_Wait(&request, MPI_STATUS_IGNORE);
+            int next_lo, next_len = block_range(first, count, key_bytes, b + 1, &next_lo);
+            if (b + 1 < blocks) {
+                file_io_check(MPI_File_iread_at_all(file, (first + next_lo) * key_bytes, block_target(row, next_lo, stage[(b + 1) % 2]),
+                                               next_len, KEY_MPI_TYPE, &request), "Reading", path, comm);
+            }
+
+            unpack_block(row + lo, stage[b % 2], len, first + lo);
+            if (scratch) {
+                parallel_local_sort_buffered(row + lo, scratch + lo, len, true, sort_config.num_threads);
+            } else {
+                local_sort(row + lo, len, true);
+            }
+            bounds[b] = lo;
+            lo = next_lo;
+            len = next_len;
+        }
+        if (local_blocks > 1) {
+            bounds[local_blocks] = count;
+            if (scratch) {
+                parallel_merge_runs_buffered(row, scratch, bounds, local_blocks, true, sort_config.num_threads);
+            } else {
+                parallel_merge_runs(row, bounds, local_blocks, true, sort_config.num_threads);
+            }
+        }
+    }
+
+    free(bounds);
+    free(stage[0]);
+    free(stage[1]);
+    MPI_File_close(&file);
+
+    double elapsed = MPI_Wtime() - start;
+    MPI_Allreduce(MPI_IN_PLACE, &elapsed, 1, MPI_DOUBLE, MPI_MAX, comm);
+    return elapsed;
+}
+
+
+double file_io_write(const char* path, const elem_t* row, int count, MPI_Comm comm) {
+    const int elem_bytes = (int)sizeof(elem_t);
+    MPI_Barrier(comm);
+    double start = MPI_Wtime();
+
+    // The rows follow each other in rank order
+    int rank;
+    long long local = count, first = 0;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Exscan(&local, &first, 1, MPI_LONG_LONG, MPI_SUM, comm);
+    if (rank == 0) first = 0;
+
+    MPI_File file = open_file(path, MPI_MODE_WRONLY | MPI_MODE_CREATE, comm);
+    file_io_check(MPI_File_set_size(file, 0), "Truncating", path, comm);
+
+    int local_blocks = count_blocks(first, count, elem_bytes);
+    int blocks;
+    MPI_Allreduce(&local_blocks, &blocks, 1, MPI_INT, MPI_MAX, comm);
+    for (int b = 0; b < blocks; b++) {
+        int lo, len = block_range(first, count, elem_bytes, b, &lo);
+        file_io_check(MPI_File_write_at_all(file, (first + lo) * elem_bytes, (void*)(row + lo), len, elem_mpi_type(), MPI_STATUS_IGNORE),
+                 "Writing", path, comm);
+    }
+    MPI_File_close(&file);
+
+    double elapsed = MPI_Wtime() - start;
+    MPI_Allreduce(MPI_IN_PLACE, &elapsed, 1, MPI_DOUBLE, MPI_MAX, comm);
+    return elapsed;
+}
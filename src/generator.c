@@ -0,0 +1,93 @@
+#include "../inc/generator.h"
+
+// Largest key of the ordered inputs (sorted, reversed, organ pipe), floats stay exact integers
+#if defined(SORT_KEY_INT64)
+    #define ORDERED_MAX  INT64_MAX
+#elif defined(SORT_KEY_FLOAT)
+    #define ORDERED_MAX  (1LL << 24)
+#else
+    #define ORDERED_MAX  INT32_MAX
+#endif
+
+
+// Random bits of a global position
+static inline uint64_t random_bits(uint64_t key, long long position) {
+    return mix64(key + (uint64_t)position * GOLDEN_GAMMA);
+}
+
+
+// Uniform key over the whole key range (floats in [-1, 1))
+static inline sort_key_t uniform_key(uint64_t bits) {
+#if defined(SORT_KEY_INT64)
+    return (sort_key_t)bits;
+#elif defined(SORT_KEY_FLOAT)
+    return (sort_key_t)((double)(bits >> 40) * 0x1p-23 - 1.0);
+#else
+    return (sort_key_t)(uint32_t)(bits >> 32);
+#endif
+}
+
+
+// Key of a position in ascending order, positions are scaled down when they exceed the key range
+static inline sort_key_t ordered_key(long long position, int shift) {
+    return (sort_key_t)(position >> shift);
+}
+
+
+// Zipf key in [1, ZIPF_VALUES]: exp of a uniform log gives the density 1/k
+static inline sort_key_t zipf_key(uint64_t bits) {
+    double u = (double)(bits >> 11) * 0x1p-53;
+    return (sort_key_t)exp(u * log((double)ZIPF_VALUES));
+}
+
+
+// The loop of one distribution, split statically across the threads: every key only depends on
+// its position, so the iterations are independent
+#if SORT_PAYLOAD
+    #define SET_ID(i, position)  row[i].id = (sort_id_t)(position)
+#else
+    #define SET_ID(i, position)  (void)(position)
+#endif
+
+#define GENERATE(expr)                                                          \
+    _Pragma("omp parallel for simd num_threads(num_threads) schedule(static)")  \
+    for (int i = 0; i < cols; i++) {                                            \
+        long long position = first + i;                                         \
+        KEY(row[i]) = (expr);                                                   \
+        SET_ID(i, position);                                                    \
+    }
+
+
+void generate_input(elem_t* row, int cols, long long first, long long total, input_dist_t dist,
+                    unsigned long long seed, int num_threads) {
+    uint64_t key = mix64((uint64_t)seed);
+    int shift = 0;
+    while (((total - 1) >> shift) > ORDERED_MAX) shift++;
+
+    switch (dist) {
+        case INPUT_UNIFORM:
+            GENERATE(uniform_key(random_bits(key, position)));
+            break;
+        case INPUT_SORTED:
+            GENERATE(ordered_key(position, shift));
+            break;
+        case INPUT_REVERSED:
+            GENERATE(ordered_key(total - 1 - position, shift));
+            break;
+        case INPUT_NEARLY_SORTED:
+            // Sorted, except for keys moved to a random position of the whole input
+            GENERATE(ordered_key((random_bits(key, position) % NEARLY_SORTED_RATE == 0)
+                                 ? (long long)((random_bits(key, position) >> 8) % (uint64_t)total) : position, shift));
+            break;
+        case INPUT_ZIPF:
+            GENERATE(zipf_key(random_bits(key, position)));
+            break;
+        case INPUT_EQUAL:
+            GENERATE((sort_key_t)1);
+            break;
+        default:
+            // Organ pipe: ascending over the first half, descending over the second one
+            GENERATE(ordered_key(2 * position < total ? 2 * position : 2 * (total - 1 - position) + 1, shift));
+            break;
+    }
+}
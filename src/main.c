@@ -2,14 +2,21 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <math.h>
+#include <limits.h>
 #include <string.h>
-#include <time.h>
-#include <unistd.h>
 #include <mpi.h>
+#include "../inc/config.h"
+#include "../inc/arena.h"
 #include "../inc/utils.h"
 #include "../inc/row_sort_operations.h"
 #include "../inc/bitonic_sort.h"
 #include "../inc/validation.h"
+#include "../inc/topology.h"
+#include "../inc/sort_engine.h"
+#include "../inc/trace.h"
+#include "../inc/generator.h"
+#include "../inc/file_io.h"
+#include "../inc/external_sort.h"
 
 
 int main(int argc, char* argv[]) {
@@ -23,66 +30,140 @@ int main(int argc, char* argv[]) {
     // Ensure all processes are ready before starting
     MPI_Barrier(MPI_COMM_WORLD);
 
-    // Use rank and hostname to generate a unique seed for each process
-    char hostname[256];
-    gethostname(hostname, sizeof(hostname));
-    srand(time(NULL) + rank + strlen(hostname));
+    bool valid_config = config_init(&argc, argv, rank);
+    if (!valid_config || !(argc == 3 || (argc == 1 && (sort_config.total_elements > 0 || sort_config.input_path)))) {
+        if (rank == 0) config_print_usage(argv[0]);
+        MPI_Finalize();
+        return 1;
+    }
+
+    // Before any thread is started, so that the counters follow all of them
+    trace_counters_open();
+
+    // The sort runs on the processes renumbered along the node/socket hierarchy
+    MPI_Comm sort_comm = MPI_COMM_WORLD;
+    if (sort_config.remap_ranks) {
+        sort_comm = topology_comm_create(MPI_COMM_WORLD);
+        MPI_Comm_rank(sort_comm, &rank);
+    }
+
+    int total_rows = size;  // Rows are the total number of processes
+    long long total_elements = sort_config.input_path ? file_io_count(sort_config.input_path, sort_comm) : sort_config.total_elements;
+    if (argc == 3) {
+        if ((1 << atoi(argv[2])) != size) {
+            if (rank == 0) printf("Error: 2^p = %d does not match the %d processes (use --elements for any count)\n", 1 << atoi(argv[2]), size);
+            MPI_Finalize();
+            return 1;
+        }
+        if (total_elements == 0) total_elements = (long long)size << atoi(argv[1]);  // 2^q elements per process
+    }
 
-    if (argc != 3) {
-        if (rank == 0) printf("Usage: %s <q: 2^q numbers/process> <p: 2^p processes>\n", argv[0]);
+    // Columns are the number of elements each process can hold, the first `N mod rows` rows get one extra element
+    long long max_cols = (total_elements + total_rows - 1) / total_rows;
+    if (max_cols > INT_MAX) {
+        if (rank == 0) printf("Error: %lld elements per process do not fit in a row\n", max_cols);
         MPI_Finalize();
         return 1;
     }
+    int total_cols = (int)max_cols;
+    int local_cols = (int)(total_elements / total_rows + (rank < total_elements % total_rows ? 1 : 0));
+
+    topology_report(sort_comm, (long long)total_cols * sizeof(elem_t));
+
+    // Every process reads or generates its own slice of the global input (record id: global position before the sort)
+    long long first_index = (total_elements / total_rows) * rank + (rank < total_elements % total_rows ? rank : total_elements % total_rows);
 
-    int total_cols = 1 << atoi(argv[1]);  // Colums are the number of elements each process has
-    int total_rows = 1 << atoi(argv[2]);  // Rows are the total number of processes
+    // Out-of-core: the rows only live in scratch files, and the sort, the check and the output stream them through `--memory`
+    if (sort_config.memory_budget > 0) {
+        trace_init(sort_comm);
+        bool sorted = external_sort(total_elements, total_cols, local_cols, first_index, sort_comm);
+        trace_finalize(sort_comm);
+        if (rank == 0) printf(sorted ? "\nSorting: Correct!!!\n" : "\nSorting: Incorrect :(\n");
 
-    int* local_row = malloc(total_cols * sizeof(int));
-    for (int i = 0; i < total_cols; i++) {
-        local_row[i] = rand() % RAND_MAX;
+        arena_release_all();
+        elem_mpi_type_release();
+        if (sort_comm != MPI_COMM_WORLD) MPI_Comm_free(&sort_comm);
+        MPI_Finalize();
+        return 0;
+    }
+
+    // The row and the scratch buffers of the sort come from the huge-page arena (`--hugepages`)
+    elem_t* local_row = (elem_t*)arena_reserve(ARENA_ROW, (size_t)total_cols * sizeof(elem_t));
+    bool presorted = false;
+    if (sort_config.input_path) {
+        presorted = sort_config.io_overlap;
+        double read_time = file_io_read(sort_config.input_path, local_row, local_cols, first_index, presorted, NULL, sort_comm);
+        if (rank == 0) {
+            double megabytes = total_elements * (double)sizeof(sort_key_t) / 1e6;
+            printf("Read: %.1f MB in %f sec (%.1f MB/s%s)\n", megabytes, read_time, megabytes / read_time,
+                   presorted ? ", overlapped with the sort of the blocks" : "");
+        }
+    } else {
+        generate_input(local_row, local_cols, first_index, total_elements, sort_config.input_dist, sort_config.seed, sort_config.num_threads);
     }
 
     // // Ensure all processes have initialized their data
-    // MPI_Barrier(MPI_COMM_WORLD);
-    // print_row(local_row, total_cols, rank, size);
+    // MPI_Barrier(sort_comm);
+    // print_row(local_row, local_cols, rank, size);
 
 
-    MPI_Barrier(MPI_COMM_WORLD);
+    // Fingerprint of the input, to check that the output is a permutation of it
+    fingerprint_t input_fingerprint = fingerprint_rows(local_row, local_cols, sort_comm);
+
+    trace_init(sort_comm);
+    long long faults[2], faults_end[2];
+    arena_page_faults(&faults[0], &faults[1]);
+    MPI_Barrier(sort_comm);
     double startTime = MPI_Wtime();
 
-    bitonic_sort(local_row, total_rows, total_cols, rank);
+    sort_engine_run(local_row, &local_cols, total_cols, presorted, sort_comm);
     
     double localEndTime = MPI_Wtime();
     double localTime = localEndTime - startTime;
-    MPI_Barrier(MPI_COMM_WORLD);
+    arena_page_faults(&faults_end[0], &faults_end[1]);
+    MPI_Barrier(sort_comm);
 
-    // Find the maximum time across all processes
+    // Page faults of the sort (mostly the first touch of the scratch buffers), summed over the processes
+    faults[0] = faults_end[0] - faults[0];
+    faults[1] = faults_end[1] - faults[1];
+    MPI_Reduce(rank == 0 ? MPI_IN_PLACE : faults, faults, 2, MPI_LONG_LONG, MPI_SUM, 0, sort_comm);
+
+    // Average, fastest and slowest time across all processes
     double sumTime;
-    MPI_Reduce(&localTime, &sumTime, 1, MPI_DOUBLE, MPI_SUM, 0, MPI_COMM_WORLD);
+    struct { double time; int rank; } localRankTime = { localTime, rank }, minTime, maxTime;
+    MPI_Reduce(&localTime, &sumTime, 1, MPI_DOUBLE, MPI_SUM, 0, sort_comm);
+    MPI_Reduce(&localRankTime, &minTime, 1, MPI_DOUBLE_INT, MPI_MINLOC, 0, sort_comm);
+    MPI_Reduce(&localRankTime, &maxTime, 1, MPI_DOUBLE_INT, MPI_MAXLOC, 0, sort_comm);
 
     if (rank == 0) {
         printf("Sorting Time: %f msec\n", (sumTime / size) * 1000);
+        printf("Rank Times: min %f msec (rank %d), max %f msec (rank %d)\n",
+               minTime.time * 1000, minTime.rank, maxTime.time * 1000, maxTime.rank);
+        printf("Page Faults: %lld minor, %lld major (sort, all processes)\n", faults[0], faults[1]);
         fflush(stdout);
     }
+    trace_finalize(sort_comm);
+
+    // The I/O bandwidth is reported apart from the sorting time
+    if (sort_config.output_path) {
+        double write_time = file_io_write(sort_config.output_path, local_row, local_cols, sort_comm);
+        if (rank == 0) {
+            double megabytes = total_elements * (double)sizeof(elem_t) / 1e6;
+            printf("Write: %.1f MB in %f sec (%.1f MB/s)\n", megabytes, write_time, megabytes / write_time);
+        }
+    }
 
     // // Ensure all processes hold the sorted result
-    // MPI_Barrier(MPI_COMM_WORLD);
-    // print_row(local_row, total_cols, rank, size);
+    // MPI_Barrier(sort_comm);
+    // print_row(local_row, local_cols, rank, size);
 
-    MPI_Barrier(MPI_COMM_WORLD);
-
-    bool eval_flag = true;
-    validate_bitonic_sort(local_row, total_cols, rank, size, &eval_flag);
-
-    // Variable to store the reduced result at rank 0
-    bool global_eval_flag = true;
-
-    // Perform logical AND reduction of all eval_flags to rank 0
-    MPI_Reduce(&eval_flag, &global_eval_flag, 1, MPI_C_BOOL, MPI_LAND, 0, MPI_COMM_WORLD);
-
-    MPI_Barrier(MPI_COMM_WORLD);
+    // Order and permutation checks, cheap enough to stay on in production runs
+    double validation_start = MPI_Wtime();
+    bool global_eval_flag = validate_sort(local_row, local_cols, &input_fingerprint, sort_comm);
+    double validation_time = MPI_Wtime() - validation_start;
 
     if (rank == 0) {
+        printf("Validation: %f msec (order and permutation of the input)\n", validation_time * 1000);
         if (global_eval_flag) {
             printf("\nSorting: Correct!!!\n");
         } else {
@@ -90,7 +171,10 @@ int main(int argc, char* argv[]) {
         }
     }
 
-    free(local_row);
+    bitonic_sort_release(sort_comm);
+    arena_release_all();
+    elem_mpi_type_release();
+    if (sort_comm != MPI_COMM_WORLD) MPI_Comm_free(&sort_comm);
 
     MPI_Finalize();
     return 0;
@@ -0,0 +1,204 @@
+#include "../inc/pairwise_kernels.h"
+#include <immintrin.h>
+
+// Every kernel is generated twice, once per direction: the ascending variant keeps
+// the minimum in `row1`, the descending one keeps the maximum, so no kernel ever
+// looks at the direction (or at the data) to decide what to do.
+// Each element type of the build (see `sort_key.h`) gets its own set of kernels.
+
+// MIN/MAX return their second operand on ties (as the x86 min/max_ps do). Calling them as
+// KEEP1(b, a) and KEEP2(a, b) leaves tied elements where they are: a process that only keeps
+// `row1` (the other row being its partner's copy) then never keeps the same element as its partner.
+#define SCALAR_MIN(a, b) (KEY(a) < KEY(b) ? (a) : (b))
+#define SCALAR_MAX(a, b) (KEY(b) < KEY(a) ? (a) : (b))
+
+#define DEFINE_SCALAR_KERNEL(name, KEEP1, KEEP2)                                    \
+    static void name(elem_t* row1, elem_t* row2, int cols) {                        \
+        for (int j = 0; j < cols; j++) {                                            \
+            elem_t a = row1[j], b = row2[j];                                        \
+            row1[j] = KEEP1(b, a);                                                  \
+            row2[j] = KEEP2(a, b);                                                  \
+        }                                                                           \
+    }                                                                               \
+    static void name##_keep(const elem_t* row1, elem_t* row2, int cols) {           \
+        for (int j = 0; j < cols; j++) {                                            \
+            elem_t a = row1[j], b = row2[j];                                        \
+            row2[j] = KEEP1(b, a);                                                  \
+        }                                                                           \
+    }
+
+// `width` elements per vector, the tail is finished with the scalar kernel of the same direction
+#define DEFINE_SIMD_KERNEL(name, target_isa, vec_t, width, LOAD, STORE, KEEP1, KEEP2, tail) \
+    __attribute__((target(target_isa)))                                             \
+    static void name(elem_t* row1, elem_t* row2, int cols) {                        \
+        int j = 0;                                                                  \
+        for (; j + width <= cols; j += width) {                                     \
+            vec_t a = LOAD((void*)(row1 + j));                                      \
+            vec_t b = LOAD((void*)(row2 + j));                                      \
+            STORE((void*)(row1 + j), KEEP1(b, a));                                  \
+            STORE((void*)(row2 + j), KEEP2(a, b));                                  \
+        }                                                                           \
+        tail(row1 + j, row2 + j, cols - j);                                         \
+    }                                                                               \
+    __attribute__((target(target_isa)))                                             \
+    static void name##_keep(const elem_t* row1, elem_t* row2, int cols) {           \
+        int j = 0;                                                                  \
+        for (; j + width <= cols; j += width) {                                     \
+            vec_t a = LOAD((const void*)(row1 + j));                                \
+            vec_t b = LOAD((void*)(row2 + j));                                      \
+            STORE((void*)(row2 + j), KEEP1(b, a));                                  \
+        }                                                                           \
+        tail##_keep(row1 + j, row2 + j, cols - j);                                  \
+    }
+
+// Defines the ascending and descending kernels of an instruction set
+#define DEFINE_SIMD_KERNELS(prefix, target_isa, vec_t, LOAD, STORE, MIN, MAX)                           \
+    DEFINE_SIMD_KERNEL(prefix##_asc,  target_isa, vec_t, (int)(sizeof(vec_t) / sizeof(elem_t)),         \
+                       LOAD, STORE, MIN, MAX, pairwise_scalar_asc)                                      \
+    DEFINE_SIMD_KERNEL(prefix##_desc, target_isa, vec_t, (int)(sizeof(vec_t) / sizeof(elem_t)),         \
+                       LOAD, STORE, MAX, MIN, pairwise_scalar_desc)
+
+DEFINE_SCALAR_KERNEL(pairwise_scalar_asc,  SCALAR_MIN, SCALAR_MAX)
+DEFINE_SCALAR_KERNEL(pairwise_scalar_desc, SCALAR_MAX, SCALAR_MIN)
+
+#if !SORT_PAYLOAD && defined(SORT_KEY_INT32)
+    #define HAS_SSE41_KERNELS
+    #define HAS_AVX2_KERNELS
+    DEFINE_SIMD_KERNELS(pairwise_sse41,  "sse4.1",  __m128i, _mm_loadu_si128,    _mm_storeu_si128,    _mm_min_epi32,    _mm_max_epi32)
+    DEFINE_SIMD_KERNELS(pairwise_avx2,   "avx2",    __m256i, _mm256_loadu_si256, _mm256_storeu_si256, _mm256_min_epi32, _mm256_max_epi32)
+    DEFINE_SIMD_KERNELS(pairwise_avx512, "avx512f", __m512i, _mm512_loadu_si512, _mm512_storeu_si512, _mm512_min_epi32, _mm512_max_epi32)
+
+#elif !SORT_PAYLOAD && defined(SORT_KEY_FLOAT)
+    #define HAS_SSE41_KERNELS
+    #define HAS_AVX2_KERNELS
+    DEFINE_SIMD_KERNELS(pairwise_sse41,  "sse4.1",  __m128, _mm_loadu_ps,    _mm_storeu_ps,    _mm_min_ps,    _mm_max_ps)
+    DEFINE_SIMD_KERNELS(pairwise_avx2,   "avx2",    __m256, _mm256_loadu_ps, _mm256_storeu_ps, _mm256_min_ps, _mm256_max_ps)
+    DEFINE_SIMD_KERNELS(pairwise_avx512, "avx512f", __m512, _mm512_loadu_ps, _mm512_storeu_ps, _mm512_min_ps, _mm512_max_ps)
+
+#elif !SORT_PAYLOAD && defined(SORT_KEY_INT64)
+    // AVX2 has no 64-bit min/max: compare and blend
+    __attribute__((target("avx2")))
+    static inline __m256i avx2_min_epi64(__m256i a, __m256i b) {
+        return _mm256_blendv_epi8(a, b, _mm256_cmpgt_epi64(a, b));
+    }
+    __attribute__((target("avx2")))
+    static inline __m256i avx2_max_epi64(__m256i a, __m256i b) {
+        return _mm256_blendv_epi8(b, a, _mm256_cmpgt_epi64(a, b));
+    }
+
+    #define HAS_AVX2_KERNELS
+    DEFINE_SIMD_KERNELS(pairwise_avx2,   "avx2",    __m256i, _mm256_loadu_si256, _mm256_storeu_si256, avx2_min_epi64,   avx2_max_epi64)
+    DEFINE_SIMD_KERNELS(pairwise_avx512, "avx512f", __m512i, _mm512_loadu_si512, _mm512_storeu_si512, _mm512_min_epi64, _mm512_max_epi64)
+
+#else
+    // Pairs: every lane takes the whole pair from the row with the smaller (larger) key.
+    // The key sits in the low half of every 8-byte pair (or in the even lane of every 16-byte pair);
+    // it is turned into a signed 64-bit value of the same order, so one compare serves both halves.
+    #if defined(SORT_KEY_INT64)
+        // Lane mask of the keys, copied to the id lane that follows each of them
+        __attribute__((target("avx512f")))
+        static inline __mmask8 avx512_pair_gt(__m512i a, __m512i b) {
+            __mmask8 keys = _mm512_cmpgt_epi64_mask(a, b) & 0x55;
+            return keys | (__mmask8)(keys << 1);
+        }
+    #else
+        // The key moves to the high half (a float key also gets its sign-magnitude made two's complement)
+        __attribute__((target("avx512f")))
+        static inline __m512i avx512_pair_order(__m512i v) {
+            __m512i key = _mm512_slli_epi64(v, 32);
+        #if defined(SORT_KEY_FLOAT)
+            key = _mm512_xor_si512(key, _mm512_srli_epi64(_mm512_srai_epi64(key, 63), 1));
+        #endif
+            return key;
+        }
+
+        __attribute__((target("avx512f")))
+        static inline __mmask8 avx512_pair_gt(__m512i a, __m512i b) {
+            return _mm512_cmpgt_epi64_mask(avx512_pair_order(a), avx512_pair_order(b));
+        }
+    #endif
+
+    __attribute__((target("avx512f")))
+    static inline __m512i avx512_pair_min(__m512i a, __m512i b) {
+        return _mm512_mask_blend_epi64(avx512_pair_gt(b, a), b, a);
+    }
+    __attribute__((target("avx512f")))
+    static inline __m512i avx512_pair_max(__m512i a, __m512i b) {
+        return _mm512_mask_blend_epi64(avx512_pair_gt(a, b), b, a);
+    }
+
+    DEFINE_SIMD_KERNELS(pairwise_avx512, "avx512f", __m512i, _mm512_loadu_si512, _mm512_storeu_si512, avx512_pair_min, avx512_pair_max)
+#endif
+
+
+// Kernel table, from the widest instruction set to the portable fallback
+typedef struct {
+    const char*            isa;
+    const char*            cpu_feature;   // NULL: always available
+    pairwise_kernel_t      asc;
+    pairwise_kernel_t      desc;
+    pairwise_keep_kernel_t keep_asc;
+    pairwise_keep_kernel_t keep_desc;
+} pairwise_kernel_entry_t;
+
+#define KERNEL_ENTRY(isa, feature, prefix) \
+    { isa, feature, prefix##_asc, prefix##_desc, prefix##_asc_keep, prefix##_desc_keep }
+
+static const pairwise_kernel_entry_t pairwise_kernels[] = {
+    KERNEL_ENTRY("avx512", "avx512f", pairwise_avx512),
+#ifdef HAS_AVX2_KERNELS
+    KERNEL_ENTRY("avx2",   "avx2",    pairwise_avx2),
+#endif
+#ifdef HAS_SSE41_KERNELS
+    KERNEL_ENTRY("sse4.1", "sse4.1",  pairwise_sse41),
+#endif
+    KERNEL_ENTRY("scalar", NULL,      pairwise_scalar),
+};
+
+#define NUM_PAIRWISE_KERNELS (int)(sizeof(pairwise_kernels) / sizeof(pairwise_kernels[0]))
+
+
+// `__builtin_cpu_supports` only accepts string literals
+static bool cpu_supports(const char* feature) {
+    if (feature == NULL) return true;
+    if (strcmp(feature, "avx512f") == 0) return __builtin_cpu_supports("avx512f");
+    if (strcmp(feature, "avx2") == 0)    return __builtin_cpu_supports("avx2");
+    if (strcmp(feature, "sse4.1") == 0)  return __builtin_cpu_supports("sse4.1");
+    return false;
+}
+
+
+// Index of the widest kernel this CPU can run
+static int best_kernel(void) {
+    int k = 0;
+    while (k < NUM_PAIRWISE_KERNELS - 1 && !cpu_supports(pairwise_kernels[k].cpu_feature)) k++;
+    return k;
+}
+
+
+pairwise_kernel_t pairwise_kernel_get(const char* isa, bool ascending) {
+    for (int k = 0; k < NUM_PAIRWISE_KERNELS; k++) {
+        if (strcmp(pairwise_kernels[k].isa, isa) == 0) {
+            if (!cpu_supports(pairwise_kernels[k].cpu_feature)) return NULL;
+            return ascending ? pairwise_kernels[k].asc : pairwise_kernels[k].desc;
+        }
+    }
+    return NULL;
+}
+
+
+pairwise_kernel_t pairwise_kernel_select(bool ascending) {
+    int k = best_kernel();
+    return ascending ? pairwise_kernels[k].asc : pairwise_kernels[k].desc;
+}
+
+
+pairwise_keep_kernel_t pairwise_keep_kernel_select(bool ascending) {
+    int k = best_kernel();
+    return ascending ? pairwise_kernels[k].keep_asc : pairwise_kernels[k].keep_desc;
+}
+
+
+const char* pairwise_kernel_isa(void) {
+    return pairwise_kernels[best_kernel()].isa;
+}
@@ -0,0 +1,164 @@
+#include "../inc/parallel_sort.h"
+
+// Scratch buffer reused by `parallel_local_sort` across calls
+static elem_t* parallel_scratch = NULL;
+
+
+// Merge path split of a diagonal (ties are taken from `a`)
+int merge_path_partition(const elem_t* a, int len_a, const elem_t* b, int len_b, int diag, bool ascending) {
+    int lo = (diag > len_b) ? diag - len_b : 0;
+    int hi = (diag < len_a) ? diag : len_a;
+
+    // a[mid] belongs to the first `diag` outputs iff it is merged before b[diag - 1 - mid]
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        bool a_first = ascending ? (KEY(a[mid]) <= KEY(b[diag - 1 - mid])) : (KEY(a[mid]) >= KEY(b[diag - 1 - mid]));
+        if (a_first) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+
+// Branchless two-way merge, `ascending` is a constant at every call site so each direction gets its own loop
+static inline void merge_runs_dir(const elem_t* a, int len_a, const elem_t* b, int len_b, elem_t* dst, const bool ascending) {
+    int i = 0, j = 0, k = 0;
+    while (i < len_a && j < len_b) {
+        elem_t x = a[i];
+        elem_t y = b[j];
+        bool take_a = ascending ? (KEY(x) <= KEY(y)) : (KEY(x) >= KEY(y));
+        dst[k++] = take_a ? x : y;
+        i += take_a;
+        j += !take_a;
+    }
+
+    // Copy whatever is left of the unfinished run
+    if (i < len_a) memcpy(dst + k, a + i, (size_t)(len_a - i) * sizeof(elem_t));
+    if (j < len_b) memcpy(dst + k, b + j, (size_t)(len_b - j) * sizeof(elem_t));
+}
+
+
+void merge_runs(const elem_t* a, int len_a, const elem_t* b, int len_b, elem_t* dst, bool ascending) {
+    if (ascending) {
+        merge_runs_dir(a, len_a, b, len_b, dst, true);
+    } else {
+        merge_runs_dir(a, len_a, b, len_b, dst, false);
+    }
+}
+
+
+// Makes the scratch buffer hold at least `cols` elements
+static void reserve_scratch(int cols) {
+    parallel_scratch = (elem_t*)arena_reserve(ARENA_MERGE, (size_t)cols * sizeof(elem_t));
+}
+
+
+// Rounds of pairwise merges of the runs delimited by `bounds`, every merge split across all the threads
+static void merge_rounds(elem_t* row, elem_t* scratch, int* bounds, int runs, bool ascending, int threads) {
+    int cols = bounds[runs];
+    elem_t* src = row;
+    elem_t* dst = scratch;
+    while (runs > 1) {
+        int pairs = runs / 2;
+
+        #pragma omp parallel for collapse(2) num_threads(threads) schedule(static)
+        for (int pair = 0; pair < pairs; pair++) {
+            for (int part = 0; part < threads; part++) {
+                int lo  = bounds[2 * pair];
+                int mid = bounds[2 * pair + 1];
+                int hi  = bounds[2 * pair + 2];
+                int len_a = mid - lo, len_b = hi - mid;
+
+                int d0 = (int)((long long)(hi - lo) * part / threads);
+                int d1 = (int)((long long)(hi - lo) * (part + 1) / threads);
+                int i0 = merge_path_partition(src + lo, len_a, src + mid, len_b, d0, ascending);
+                int i1 = merge_path_partition(src + lo, len_a, src + mid, len_b, d1, ascending);
+
+                merge_runs(src + lo + i0, i1 - i0, src + mid + (d0 - i0), (d1 - i1) - (d0 - i0), dst + lo + d0, ascending);
+            }
+        }
+
+        // An odd run out has no partner in this round
+        if (runs % 2 == 1) {
+            int lo = bounds[runs - 1];
+            memcpy(dst + lo, src + lo, (size_t)(bounds[runs] - lo) * sizeof(elem_t));
+        }
+
+        // Merged runs span every other boundary
+        int merged = 0;
+        for (int r = 0; r < runs; r += 2) {
+            bounds[merged++] = bounds[r];
+        }
+        bounds[merged] = cols;
+        runs = merged;
+
+        elem_t* tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    if (src != row) {
+        memcpy(row, src, (size_t)cols * sizeof(elem_t));
+    }
+}
+
+
+// Multithreaded local sort: per-thread radix sorts, then rounds of parallel merge path merges
+void parallel_local_sort_buffered(elem_t* row, elem_t* scratch, int cols, bool ascending, int num_threads) {
+    if (row == NULL || cols <= 1) return;
+
+    int threads = num_threads;
+    if (threads > cols / MIN_ELEMENTS_PER_THREAD) threads = cols / MIN_ELEMENTS_PER_THREAD;
+    if (threads <= 1) {
+        radix_sort_buffered(row, scratch, cols, ascending);
+        return;
+    }
+
+    // Step 1: Every thread sorts its own slice
+    int bounds[threads + 1];
+    for (int t = 0; t <= threads; t++) {
+        bounds[t] = (int)((long long)cols * t / threads);
+    }
+
+    #pragma omp parallel for num_threads(threads) schedule(static)
+    for (int t = 0; t < threads; t++) {
+        radix_sort_buffered(row + bounds[t], scratch + bounds[t], bounds[t + 1] - bounds[t], ascending);
+    }
+
+    // Step 2: Merge the sorted runs pairwise
+    merge_rounds(row, scratch, bounds, threads, ascending, threads);
+}
+
+
+void parallel_local_sort(elem_t* row, int cols, bool ascending, int num_threads) {
+    if (row == NULL || cols <= 1) return;
+    reserve_scratch(cols);
+    parallel_local_sort_buffered(row, parallel_scratch, cols, ascending, num_threads);
+}
+
+
+// k-way merge of consecutive sorted runs as rounds of pairwise merges
+void parallel_merge_runs_buffered(elem_t* row, elem_t* scratch, int* bounds, int runs, bool ascending, int num_threads) {
+    if (row == NULL || runs <= 1 || bounds[runs] <= 1) return;
+
+    int threads = num_threads;
+    if (threads > bounds[runs] / MIN_ELEMENTS_PER_THREAD) threads = bounds[runs] / MIN_ELEMENTS_PER_THREAD;
+    if (threads < 1) threads = 1;
+    merge_rounds(row, scratch, bounds, runs, ascending, threads);
+}
+
+
+void parallel_merge_runs(elem_t* row, int* bounds, int runs, bool ascending, int num_threads) {
+    if (row == NULL || runs <= 1 || bounds[runs] <= 1) return;
+    reserve_scratch(bounds[runs]);
+    parallel_merge_runs_buffered(row, parallel_scratch, bounds, runs, ascending, num_threads);
+}
+
+
+void parallel_sort_release(void) {
+    arena_release(ARENA_MERGE);
+    parallel_scratch = NULL;
+}
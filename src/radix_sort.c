@@ -0,0 +1,98 @@
+#include "../inc/radix_sort.h"
+
+// Scratch buffer reused by `radix_sort` across calls
+static elem_t* radix_scratch = NULL;
+
+
+// Radix digits of a key: `key_to_bits` gives the ascending order, flipping every bit reverses it
+static inline key_bits_t radix_key(elem_t value, key_bits_t mask) {
+    return key_to_bits(KEY(value)) ^ mask;
+}
+
+
+// Insertion sort for short rows, where the histogram passes do not pay off
+static void insertion_sort(elem_t* row, int cols, bool ascending) {
+    for (int i = 1; i < cols; i++) {
+        elem_t value = row[i];
+        int j = i - 1;
+        if (ascending) {
+            while (j >= 0 && KEY(row[j]) > KEY(value)) { row[j + 1] = row[j]; j--; }
+        } else {
+            while (j >= 0 && KEY(row[j]) < KEY(value)) { row[j + 1] = row[j]; j--; }
+        }
+        row[j + 1] = value;
+    }
+}
+
+
+// LSD radix sort through a caller-provided scratch buffer
+void radix_sort_buffered(elem_t* row, elem_t* scratch, int cols, bool ascending) {
+    if (row == NULL || cols <= 1) return;
+
+    if (cols < RADIX_SMALL_CUTOFF) {
+        insertion_sort(row, cols, ascending);
+        return;
+    }
+
+    const key_bits_t mask = ascending ? 0 : ~(key_bits_t)0;
+    const int passes = KEY_BITS / RADIX_BITS;
+
+    // Build the histograms of every digit in a single pass over the row
+    size_t hist[KEY_BITS / RADIX_BITS][RADIX_BUCKETS];
+    memset(hist, 0, sizeof(hist));
+    for (int i = 0; i < cols; i++) {
+        key_bits_t key = radix_key(row[i], mask);
+        for (int pass = 0; pass < passes; pass++) {
+            hist[pass][(key >> (pass * RADIX_BITS)) & (RADIX_BUCKETS - 1)]++;
+        }
+    }
+
+    elem_t* src = row;
+    elem_t* dst = scratch;
+    for (int pass = 0; pass < passes; pass++) {
+        int shift = pass * RADIX_BITS;
+        size_t* count = hist[pass];
+
+        // A digit shared by every key does not reorder anything, skip its scatter
+        key_bits_t first_digit = radix_key(src[0], mask) >> shift & (RADIX_BUCKETS - 1);
+        if (count[first_digit] == (size_t)cols) continue;
+
+        // Exclusive prefix sum turns counts into bucket offsets
+        size_t offset = 0;
+        for (int b = 0; b < RADIX_BUCKETS; b++) {
+            size_t c = count[b];
+            count[b] = offset;
+            offset += c;
+        }
+
+        for (int i = 0; i < cols; i++) {
+            elem_t value = src[i];
+            key_bits_t digit = (radix_key(value, mask) >> shift) & (RADIX_BUCKETS - 1);
+            dst[count[digit]++] = value;
+        }
+
+        elem_t* tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    // An odd number of scatters leaves the result in the scratch buffer
+    if (src != row) {
+        memcpy(row, src, (size_t)cols * sizeof(elem_t));
+    }
+}
+
+
+// LSD radix sort using the module's persistent scratch buffer
+void radix_sort(elem_t* row, int cols, bool ascending) {
+    if (row == NULL || cols <= 1) return;
+
+    radix_scratch = (elem_t*)arena_reserve(ARENA_RADIX, (size_t)cols * sizeof(elem_t));
+    radix_sort_buffered(row, radix_scratch, cols, ascending);
+}
+
+
+void radix_sort_release(void) {
+    arena_release(ARENA_RADIX);
+    radix_scratch = NULL;
+}
@@ -3,63 +3,228 @@
 
 // Pairwise sort between two rows
 // A pair is a [ row1[j], row2[j] ]
-void pairwise_sort(int* row1, int* row2, int cols, bool ascending) {
-    for (int j = 0; j < cols; j++) {
-        if ( (ascending && row1[j] > row2[j]) || (!ascending && row1[j] < row2[j]) ) {
-            int temp = row1[j];
-            row1[j] = row2[j];
-            row2[j] = temp;
-        }
+// The direction is resolved once per call into a branchless min/max kernel (see `pairwise_kernels.c`)
+void pairwise_sort(elem_t* row1, elem_t* row2, int cols, bool ascending) {
+    pairwise_kernel_select(ascending)(row1, row2, cols);
+}
+
+
+// Keeps the `row1` side of every pair, over `row2` (see `pairwise_keep_kernel_t`)
+void pairwise_keep(const elem_t* row1, elem_t* row2, int cols, bool ascending) {
+    pairwise_keep_kernel_select(ascending)(row1, row2, cols);
+}
+
+
+// Scratch buffer reused by `elbow_sort` across calls
+static elem_t* elbow_scratch = NULL;
+
+
+// Min/max value of a short block (a plain reduction, so the compiler vectorizes it)
+static inline sort_key_t block_extreme(const elem_t* arr, int len, const bool find_min) {
+    sort_key_t best = KEY(arr[0]);
+    for (int i = 1; i < len; i++) {
+        sort_key_t key = KEY(arr[i]);
+        best = find_min ? (key < best ? key : best) : (key > best ? key : best);
+    }
+    return best;
+}
+
+
+// Folds a block into the running elbow: the index is only searched for when the block
+// holds a strictly better value, so the first min/max of the whole row is kept
+static inline void track_elbow(const elem_t* block, int offset, int len, bool find_min, int* best_idx, sort_key_t* best_val) {
+    sort_key_t value = find_min ? block_extreme(block, len, true) : block_extreme(block, len, false);
+    if (*best_idx < 0 || (find_min ? value < *best_val : value > *best_val)) {
+        int i = 0;
+        while (KEY(block[i]) != value) i++;
+        *best_idx = offset + i;
+        *best_val = value;
     }
 }
 
 
 // Helper function to find the index of min/max(elbow) element in array
-int find_elbow_element(const int* arr, int len_arr, bool find_min) {
-    int elbow_idx = 0;
-    for (int i = 1; i < len_arr; i++) {
-        if ( (find_min && arr[i] < arr[elbow_idx]) || (!find_min && arr[i] > arr[elbow_idx]) ) {
-            elbow_idx = i;
-        }
+int find_elbow_element(const elem_t* arr, int len_arr, bool find_min) {
+    int elbow_idx = -1;
+    sort_key_t elbow_val = 0;
+    for (int offset = 0; offset < len_arr; offset += ELBOW_BLOCK) {
+        int len = (offset + ELBOW_BLOCK <= len_arr) ? ELBOW_BLOCK : len_arr - offset;
+        track_elbow(arr + offset, offset, len, find_min, &elbow_idx, &elbow_val);
     }
-    return elbow_idx;
+    return (elbow_idx < 0) ? 0 : elbow_idx;
 }
 
 
-// Performs sorting within a single row using the elbow pattern
-void elbow_sort(int* row, int cols, bool ascending) {
-    if (cols <= 1) return;  // Already sorted
-    
-    // Allocate tmp buffer
-    int* tmp_buff = (int*)malloc(cols * sizeof(int));
-    if (!tmp_buff) return;  // Handle allocation failure
-    
-    // Find the elbow point (min/max element)
-    int left = find_elbow_element(row, cols, ascending);
-    int right = (left == cols - 1) ? 0 : left + 1;
-    
+// Pairwise sort fused with the elbow search of row1: each block is searched right after its
+// compare-exchange, while it is still in cache, instead of in a separate pass over the row
+int pairwise_sort_elbow(elem_t* row1, elem_t* row2, int cols, bool ascending, bool find_min, int* opposite_idx) {
+    pairwise_kernel_t kernel = pairwise_kernel_select(ascending);
+
+    int elbow_idx = -1, opposite = -1;
+    sort_key_t elbow_val = 0, opposite_val = 0;
+    for (int offset = 0; offset < cols; offset += ELBOW_BLOCK) {
+        int len = (offset + ELBOW_BLOCK <= cols) ? ELBOW_BLOCK : cols - offset;
+        kernel(row1 + offset, row2 + offset, len);
+        track_elbow(row1 + offset, offset, len, find_min, &elbow_idx, &elbow_val);
+        if (opposite_idx) track_elbow(row1 + offset, offset, len, !find_min, &opposite, &opposite_val);
+    }
+
+    if (opposite_idx) *opposite_idx = (opposite < 0) ? 0 : opposite;
+    return (elbow_idx < 0) ? 0 : elbow_idx;
+}
+
+
+// Keeping variant of `pairwise_sort_elbow`: the kept elements are written over `row2` and searched there
+int pairwise_keep_elbow(const elem_t* row1, elem_t* row2, int cols, bool ascending, bool find_min, int* opposite_idx) {
+    pairwise_keep_kernel_t kernel = pairwise_keep_kernel_select(ascending);
+
+    int elbow_idx = -1, opposite = -1;
+    sort_key_t elbow_val = 0, opposite_val = 0;
+    for (int offset = 0; offset < cols; offset += ELBOW_BLOCK) {
+        int len = (offset + ELBOW_BLOCK <= cols) ? ELBOW_BLOCK : cols - offset;
+        kernel(row1 + offset, row2 + offset, len);
+        track_elbow(row2 + offset, offset, len, find_min, &elbow_idx, &elbow_val);
+        if (opposite_idx) track_elbow(row2 + offset, offset, len, !find_min, &opposite, &opposite_val);
+    }
+
+    if (opposite_idx) *opposite_idx = (opposite < 0) ? 0 : opposite;
+    return (elbow_idx < 0) ? 0 : elbow_idx;
+}
+
+
+// Branchless elbow merge, `ascending` is a constant at every call site so each direction gets its own loop.
+// `left` walks down from the elbow and `right` walks up from the next element, both wrapping around
+// the row with a conditional move instead of a modulo.
+static inline void elbow_merge_dir(const elem_t* src, elem_t* dst, int cols, int elbow, const bool ascending) {
+    int left = elbow;
+    int right = (elbow == cols - 1) ? 0 : elbow + 1;
+
     for (int i = 0; i < cols; i++) {
-        bool compare;
-        if (ascending) {
-            compare = row[left] <= row[right];
+        elem_t l = src[left];
+        elem_t r = src[right];
+        bool take_left = ascending ? (KEY(l) <= KEY(r)) : (KEY(l) >= KEY(r));
+        dst[i] = take_left ? l : r;
+
+        int next_left  = (left == 0) ? cols - 1 : left - 1;
+        int next_right = (right == cols - 1) ? 0 : right + 1;
+        left  = take_left ? next_left : left;
+        right = take_left ? right : next_right;
+    }
+}
+
+
+// Merges the two monotone runs around the elbow into `dst`
+void elbow_merge(const elem_t* src, elem_t* dst, int cols, int elbow, bool ascending) {
+    if (cols <= 0) return;
+
+    if (ascending) {
+        elbow_merge_dir(src, dst, cols, elbow, true);
+    } else {
+        elbow_merge_dir(src, dst, cols, elbow, false);
+    }
+}
+
+
+// The two runs of a bitonic row, seen from its elbow: run A walks down from the elbow and run B
+// walks up from the next element, both wrapping around the row. B ends at the opposite extreme,
+// so A[i] = src[elbow - i] for i < len_a and B[j] = src[elbow + 1 + j] for j < len_b (mod cols).
+static inline int cyclic_index(long long index, int cols) {
+    long long wrapped = index % cols;
+    return (int)(wrapped < 0 ? wrapped + cols : wrapped);
+}
+
+
+// Merge path split of the elbow runs (ties are taken from run A, as in `elbow_merge`)
+static int elbow_merge_partition(const elem_t* src, int cols, int elbow, int len_a, int len_b, int diag, bool ascending) {
+    int lo = (diag > len_b) ? diag - len_b : 0;
+    int hi = (diag < len_a) ? diag : len_a;
+
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        sort_key_t a = KEY(src[cyclic_index((long long)elbow - mid, cols)]);
+        sort_key_t b = KEY(src[cyclic_index((long long)elbow + diag - mid, cols)]);
+        bool a_first = ascending ? (a <= b) : (a >= b);
+        if (a_first) {
+            lo = mid + 1;
         } else {
-            compare = row[left] >= row[right];
+            hi = mid;
         }
-        
-        if (compare) {
-            tmp_buff[i] = row[left];
-            left = (left == 0) ? cols - 1 : left - 1;
+    }
+    return lo;
+}
+
+
+// Bounded version of `elbow_merge_dir`: merges `len_a` elements of run A starting at index `left`
+// with `len_b` elements of run B starting at index `right`
+static inline void elbow_merge_range_dir(const elem_t* src, elem_t* dst, int cols, int left, int right,
+                                         int len_a, int len_b, const bool ascending) {
+    int total = len_a + len_b;
+    for (int i = 0; i < total; i++) {
+        elem_t l = src[left];
+        elem_t r = src[right];
+        bool take_left = (len_b == 0) || (len_a > 0 && (ascending ? (KEY(l) <= KEY(r)) : (KEY(l) >= KEY(r))));
+        dst[i] = take_left ? l : r;
+
+        int next_left  = (left == 0) ? cols - 1 : left - 1;
+        int next_right = (right == cols - 1) ? 0 : right + 1;
+        left  = take_left ? next_left : left;
+        right = take_left ? right : next_right;
+        len_a -= take_left;
+        len_b -= !take_left;
+    }
+}
+
+
+// Elbow merge split across threads: each thread produces an equal slice of the output,
+// starting from its own merge path split of the two runs
+void elbow_merge_parallel(const elem_t* src, elem_t* dst, int cols, int elbow, int opposite, bool ascending, int num_threads) {
+    int threads = num_threads;
+    if (threads > cols / MIN_ELEMENTS_PER_THREAD) threads = cols / MIN_ELEMENTS_PER_THREAD;
+    if (threads <= 1) {
+        elbow_merge(src, dst, cols, elbow, ascending);
+        return;
+    }
+
+    int len_b = cyclic_index((long long)opposite - elbow, cols);
+    int len_a = cols - len_b;
+
+    #pragma omp parallel for num_threads(threads) schedule(static)
+    for (int t = 0; t < threads; t++) {
+        int d0 = (int)((long long)cols * t / threads);
+        int d1 = (int)((long long)cols * (t + 1) / threads);
+        int i0 = elbow_merge_partition(src, cols, elbow, len_a, len_b, d0, ascending);
+        int i1 = elbow_merge_partition(src, cols, elbow, len_a, len_b, d1, ascending);
+
+        int left  = cyclic_index((long long)elbow - i0, cols);
+        int right = cyclic_index((long long)elbow + 1 + (d0 - i0), cols);
+        if (ascending) {
+            elbow_merge_range_dir(src, dst + d0, cols, left, right, i1 - i0, (d1 - i1) - (d0 - i0), true);
         } else {
-            tmp_buff[i] = row[right];
-            right = (right + 1) % cols;
+            elbow_merge_range_dir(src, dst + d0, cols, left, right, i1 - i0, (d1 - i1) - (d0 - i0), false);
         }
     }
-    
-    // Copy tmp_buff buffer back to original array
-    memcpy(row, tmp_buff, cols * sizeof(int));
-    
-    // Clean up
-    free(tmp_buff);
+}
+
+
+// Performs sorting within a single row using the elbow pattern
+void elbow_sort(elem_t* row, int cols, bool ascending) {
+    if (cols <= 1) return;  // Already sorted
+
+    // The arena only remaps the tmp buffer when a larger row shows up
+    elbow_scratch = (elem_t*)arena_reserve(ARENA_ELBOW, (size_t)cols * sizeof(elem_t));
+
+    // Find the elbow point (min/max element) and merge around it
+    int elbow = find_elbow_element(row, cols, ascending);
+    elbow_merge(row, elbow_scratch, cols, elbow, ascending);
+
+    // Copy tmp buffer back to original array
+    memcpy(row, elbow_scratch, (size_t)cols * sizeof(elem_t));
+}
+
+
+void elbow_sort_release(void) {
+    arena_release(ARENA_ELBOW);
+    elbow_scratch = NULL;
 }
 
 
@@ -87,3 +252,63 @@ void elbow_sort(int* row, int cols, bool ascending) {
 //         }
 //     }
 // }
+
+
+// In-place half-cleaners from segments of `cols` down to segments of `block`, then a bounded
+// elbow merge of every block
+void bitonic_merge_bounded(elem_t* row, int cols, int block, bool ascending, int num_threads) {
+    if (block > cols) block = cols;
+    int segment = (block > HALF_CLEANER_SEGMENT) ? block : HALF_CLEANER_SEGMENT;
+    if (segment > cols) segment = cols;
+
+    // Levels above a segment: one pass over the row each, on the pairs (i, i + half) of every span
+    // of 2 * half, cut into pieces that never straddle two spans
+    for (int half = cols / 2; half >= segment; half /= 2) {
+        int piece = (half < HALF_CLEANER_PIECE) ? half : HALF_CLEANER_PIECE;
+        int pieces = cols / 2 / piece;
+        #pragma omp parallel for num_threads(num_threads) schedule(static)
+        for (int p = 0; p < pieces; p++) {
+            int pair = p * piece;
+            int first = (pair / half) * 2 * half + pair % half;
+            pairwise_sort(row + first, row + first + half, piece, ascending);
+        }
+    }
+
+    // One block per thread, mapped by the first merge and reused by the next ones
+    elem_t* scratch = (elem_t*)arena_reserve(ARENA_BLOCKS, (size_t)num_threads * block * sizeof(elem_t));
+    #pragma omp parallel num_threads(num_threads)
+    {
+        elem_t* own = scratch + (size_t)omp_get_thread_num() * block;
+        #pragma omp for schedule(static)
+        for (int s = 0; s < cols / segment; s++) {
+            elem_t* span = row + (size_t)s * segment;
+            for (int half = segment / 2; half >= block; half /= 2) {
+                for (int first = 0; first < segment; first += 2 * half) pairwise_sort(span + first, span + first + half, half, ascending);
+            }
+            for (int b = 0; b < segment / block; b++) {
+                elem_t* part = span + (size_t)b * block;
+                elbow_merge(part, own, block, find_elbow_element(part, block, ascending), ascending);
+                memcpy(part, own, (size_t)block * sizeof(elem_t));
+            }
+        }
+    }
+}
+
+
+// Local bitonic sort whose base case is a block: neighbor blocks sorted in opposite directions
+// form the bitonic segments of the first merge level
+void bitonic_sort_bounded(elem_t* row, int cols, int block, bool ascending, int num_threads) {
+    if (block >= cols) {
+        local_sort(row, cols, ascending);
+        return;
+    }
+
+    for (int b = 0; b < cols / block; b++) {
+        local_sort(row + (size_t)b * block, block, (b % 2 == 0) == ascending);
+    }
+    for (int size = 2 * block; size <= cols; size *= 2) {
+        for (int s = 0; s < cols / size; s++) {
+            bitonic_merge_bounded(row + (size_t)s * size, size, block, (s % 2 == 0) == ascending, num_threads);
+        }
+    }
+}
@@ -0,0 +1,240 @@
+#include "../inc/sample_sort.h"
+
+// Sample/splitter: a key and the (rank, position) it was taken from, which orders equal keys
+typedef struct {
+    sort_key_t value;
+    int rank;
+    int index;
+} sample_t;
+
+
+static int compare_samples(const void* a, const void* b) {
+    const sample_t* x = (const sample_t*)a;
+    const sample_t* y = (const sample_t*)b;
+    if (x->value != y->value) return (x->value > y->value) - (x->value < y->value);
+    if (x->rank != y->rank) return (x->rank > y->rank) - (x->rank < y->rank);
+    return (x->index > y->index) - (x->index < y->index);
+}
+
+
+// Datatype of `sample_t`: the key type, then the rank and the position
+static MPI_Datatype sample_mpi_type(void) {
+    int lengths[3] = { 1, 1, 1 };
+    MPI_Aint displs[3] = { offsetof(sample_t, value), offsetof(sample_t, rank), offsetof(sample_t, index) };
+    MPI_Datatype types[3] = { KEY_MPI_TYPE, MPI_INT, MPI_INT };
+
+    MPI_Datatype packed, sample_type;
+    MPI_Type_create_struct(3, lengths, displs, types, &packed);
+    MPI_Type_create_resized(packed, 0, sizeof(sample_t), &sample_type);
+    MPI_Type_commit(&sample_type);
+    MPI_Type_free(&packed);
+    return sample_type;
+}
+
+
+// First position of an ascending row whose element is >= `value` (> `value` if `inclusive`)
+static int row_bound(const elem_t* row, int count, sort_key_t value, bool inclusive) {
+    int lo = 0, hi = count;
+    while (lo < hi) {
+        int mid = lo + (hi - lo) / 2;
+        bool before = inclusive ? (KEY(row[mid]) <= value) : (KEY(row[mid]) < value);
+        if (before) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+
+// Number of local elements ordered before a splitter (keys first, then rank, then position)
+static int split_point(const elem_t* row, int count, int rank, const sample_t* splitter) {
+    if (rank < splitter->rank) return row_bound(row, count, splitter->value, true);
+    if (rank > splitter->rank) return row_bound(row, count, splitter->value, false);
+    return splitter->index;
+}
+
+
+static void* checked_malloc(size_t bytes, int rank, MPI_Comm comm) {
+    void* ptr = malloc(bytes > 0 ? bytes : 1);
+    if (!ptr) {
+        fprintf(stderr, "Rank %d: Memory allocation failed\n", rank);
+        MPI_Abort(comm, -1);
+    }
+    return ptr;
+}
+
+
+// Picks the `size - 1` global splitters from regular samples of the sorted rows
+static void select_splitters(const elem_t* row, int count, int rank, int size, sample_t* splitters, MPI_Comm comm) {
+    // Samples split the local row into `size` even parts (fewer samples if the row is shorter)
+    int num_samples = (count < size - 1) ? count : size - 1;
+    sample_t* samples = checked_malloc((size_t)num_samples * sizeof(sample_t), rank, comm);
+    for (int i = 0; i < num_samples; i++) {
+        int index = (int)((long long)(i + 1) * count / (num_samples + 1));
+        samples[i] = (sample_t){ KEY(row[index]), rank, index };
+    }
+
+    // Every process gathers all the samples
+    int* sample_counts = checked_malloc((size_t)size * sizeof(int), rank, comm);
+    int* sample_displs = checked_malloc((size_t)size * sizeof(int), rank, comm);
+    trace_wait_begin();
+    MPI_Allgather(&num_samples, 1, MPI_INT, sample_counts, 1, MPI_INT, comm);
+    trace_wait_end();
+    int total_samples = 0;
+    for (int r = 0; r < size; r++) {
+        sample_displs[r] = total_samples;
+        total_samples += sample_counts[r];
+    }
+
+    MPI_Datatype sample_type = sample_mpi_type();
+    sample_t* all_samples = checked_malloc((size_t)total_samples * sizeof(sample_t), rank, comm);
+    trace_wait_begin();
+    MPI_Allgatherv(samples, num_samples, sample_type, all_samples, sample_counts, sample_displs, sample_type, comm);
+    trace_wait_end();
+    MPI_Type_free(&sample_type);
+    qsort(all_samples, total_samples, sizeof(sample_t), compare_samples);
+
+    // Splitters are evenly spaced in the sorted samples
+    for (int i = 0; i < size - 1; i++) {
+        splitters[i] = all_samples[(long long)(i + 1) * total_samples / size];
+    }
+
+    free(samples);
+    free(sample_counts);
+    free(sample_displs);
+    free(all_samples);
+}
+
+
+// Moves the sorted elements (held[r] on rank r, in rank order) so that every row is full
+// except the last non-empty one
+static void rebalance(const elem_t* sorted, int held, elem_t* local_row, int* count, int capacity, int rank, int size, MPI_Comm comm) {
+    long long* all_held = checked_malloc((size_t)size * sizeof(long long), rank, comm);
+    long long local_held = held;
+    trace_wait_begin();
+    MPI_Allgather(&local_held, 1, MPI_LONG_LONG, all_held, 1, MPI_LONG_LONG, comm);
+    trace_wait_end();
+
+    long long total = 0, offset = 0;
+    for (int r = 0; r < size; r++) {
+        if (r == rank) offset = total;
+        total += all_held[r];
+    }
+
+    int* send_counts = checked_malloc((size_t)size * sizeof(int), rank, comm);
+    int* send_displs = checked_malloc((size_t)size * sizeof(int), rank, comm);
+    int* recv_counts = checked_malloc((size_t)size * sizeof(int), rank, comm);
+    int* recv_displs = checked_malloc((size_t)size * sizeof(int), rank, comm);
+
+    // Row r ends up with the global positions [r * capacity, (r + 1) * capacity) that exist
+    long long target_lo = (long long)rank * capacity;
+    long long target_hi = (target_lo + capacity < total) ? target_lo + capacity : total;
+    long long source_lo = 0;
+    for (int r = 0; r < size; r++) {
+        // What this process sends to row r
+        long long lo = (long long)r * capacity;
+        long long hi = lo + capacity;
+        if (lo < offset) lo = offset;
+        if (hi > offset + held) hi = offset + held;
+        send_counts[r] = (hi > lo) ? (int)(hi - lo) : 0;
+        send_displs[r] = (hi > lo) ? (int)(lo - offset) : 0;
+
+        // What this process receives from process r
+        long long source_hi = source_lo + all_held[r];
+        lo = (source_lo > target_lo) ? source_lo : target_lo;
+        hi = (source_hi < target_hi) ? source_hi : target_hi;
+        recv_counts[r] = (hi > lo) ? (int)(hi - lo) : 0;
+        recv_displs[r] = (hi > lo) ? (int)(lo - target_lo) : 0;
+        source_lo = source_hi;
+    }
+
+    trace_wait_begin();
+    MPI_Alltoallv(sorted, send_counts, send_displs, elem_mpi_type(), local_row, recv_counts, recv_displs, elem_mpi_type(), comm);
+    trace_wait_end();
+    trace_bytes((long long)(held - send_counts[rank]) * sizeof(elem_t),
+                (long long)(target_hi - target_lo - recv_counts[rank]) * sizeof(elem_t));
+    *count = (target_hi > target_lo) ? (int)(target_hi - target_lo) : 0;
+
+    free(all_held);
+    free(send_counts);
+    free(send_displs);
+    free(recv_counts);
+    free(recv_displs);
+}
+
+
+void sample_sort(elem_t* local_row, int* count, int capacity, bool presorted, MPI_Comm comm) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    // Step 1: Local sort
+    if (!presorted) {
+        trace_begin(TRACE_LOCAL_SORT, -1, -1, -1);
+        local_sort(local_row, *count, true);
+        trace_end();
+    }
+    if (size == 1) return;
+
+    // Step 2: Splitters from regular samples
+    trace_begin(TRACE_SPLITTERS, -1, -1, -1);
+    sample_t* splitters = checked_malloc((size_t)(size - 1) * sizeof(sample_t), rank, comm);
+    select_splitters(local_row, *count, rank, size, splitters, comm);
+    trace_end();
+
+    // Step 3: Every bucket goes to its process in a single all-to-all
+    trace_begin(TRACE_ALLTOALL, -1, -1, -1);
+    int* send_counts = checked_malloc((size_t)size * sizeof(int), rank, comm);
+    int* send_displs = checked_malloc((size_t)(size + 1) * sizeof(int), rank, comm);
+    int* recv_counts = checked_malloc((size_t)size * sizeof(int), rank, comm);
+    int* recv_displs = checked_malloc((size_t)(size + 1) * sizeof(int), rank, comm);
+
+    send_displs[0] = 0;
+    for (int r = 1; r < size; r++) {
+        send_displs[r] = split_point(local_row, *count, rank, &splitters[r - 1]);
+    }
+    send_displs[size] = *count;
+    for (int r = 0; r < size; r++) {
+        send_counts[r] = send_displs[r + 1] - send_displs[r];
+    }
+
+    trace_wait_begin();
+    MPI_Alltoall(send_counts, 1, MPI_INT, recv_counts, 1, MPI_INT, comm);
+    trace_wait_end();
+    long long received = 0;
+    for (int r = 0; r < size; r++) {
+        recv_displs[r] = (int)received;
+        received += recv_counts[r];
+    }
+    if (received > INT_MAX) {
+        fprintf(stderr, "Rank %d: Bucket of %lld elements does not fit in a row\n", rank, received);
+        MPI_Abort(comm, -1);
+    }
+    recv_displs[size] = (int)received;
+
+    elem_t* bucket = (elem_t*)arena_reserve(ARENA_SPARE, (size_t)received * sizeof(elem_t));
+    trace_wait_begin();
+    MPI_Alltoallv(local_row, send_counts, send_displs, elem_mpi_type(), bucket, recv_counts, recv_displs, elem_mpi_type(), comm);
+    trace_wait_end();
+    trace_bytes((long long)(*count - send_counts[rank]) * sizeof(elem_t), (received - recv_counts[rank]) * (long long)sizeof(elem_t));
+    trace_end();
+
+    // Step 4: k-way merge of the received runs (one per process)
+    trace_begin(TRACE_MERGE, -1, -1, -1);
+    parallel_merge_runs(bucket, recv_displs, size, true, sort_config.num_threads);
+    trace_end();
+
+    // Step 5: Restore the row layout of the bitonic sort
+    trace_begin(TRACE_ALLTOALL, -1, -1, -1);
+    rebalance(bucket, (int)received, local_row, count, capacity, rank, size, comm);
+    trace_end();
+
+    // Clean up
+    free(splitters);
+    free(send_counts);
+    free(send_displs);
+    free(recv_counts);
+    free(recv_displs);
+}
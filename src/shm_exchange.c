@@ -0,0 +1,131 @@
+#include "../inc/shm_exchange.h"
+
+
+// Creates the shared window of the node
+void shm_context_create(shm_context_t* ctx, int cols, bool with_window, MPI_Comm comm) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &ctx->node_comm);
+    ctx->cols = cols;
+    ctx->rows = NULL;
+    ctx->win = MPI_WIN_NULL;
+
+    // Map every process of the sort to its rank on this node
+    ctx->node_rank = malloc(size * sizeof(int));
+    int* all_ranks = malloc(size * sizeof(int));
+    if (!ctx->node_rank || !all_ranks) {
+        fprintf(stderr, "Rank %d: Memory allocation failed\n", rank);
+        MPI_Abort(comm, -1);
+    }
+    for (int r = 0; r < size; r++) all_ranks[r] = r;
+
+    MPI_Group group, node_group;
+    MPI_Comm_group(comm, &group);
+    MPI_Comm_group(ctx->node_comm, &node_group);
+    MPI_Group_translate_ranks(group, size, all_ranks, node_group, ctx->node_rank);
+    for (int r = 0; r < size; r++) {
+        if (ctx->node_rank[r] == MPI_UNDEFINED) ctx->node_rank[r] = -1;
+    }
+    MPI_Group_free(&group);
+    MPI_Group_free(&node_group);
+    free(all_ranks);
+
+    if (!with_window) return;
+
+    // Without a partner on the node, the window would only cost a copy of the row in and out
+    int has_partner = 0;
+    for (int step = 0; (1 << step) < size; step++) {
+        int partner = rank ^ (1 << step);
+        if (partner < size && ctx->node_rank[partner] >= 0) has_partner = 1;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, &has_partner, 1, MPI_INT, MPI_LOR, ctx->node_comm);
+    if (!has_partner) return;
+
+    // Non-contiguous segments let each process allocate (and first touch) its rows locally
+    MPI_Info info;
+    MPI_Info_create(&info);
+    MPI_Info_set(info, "alloc_shared_noncontig", "true");
+    MPI_Win_allocate_shared((MPI_Aint)2 * cols * sizeof(elem_t), sizeof(elem_t), info, ctx->node_comm, &ctx->rows, &ctx->win);
+    MPI_Info_free(&info);
+
+    // A single passive epoch for all the sorts, the exchanges only need window syncs
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, ctx->win);
+}
+
+
+void shm_context_free(shm_context_t* ctx) {
+    if (ctx->rows) {
+        MPI_Win_unlock_all(ctx->win);
+        MPI_Win_free(&ctx->win);
+    }
+    MPI_Comm_free(&ctx->node_comm);
+    free(ctx->node_rank);
+    ctx->rows = NULL;
+    ctx->node_rank = NULL;
+}
+
+
+bool shm_is_local(const shm_context_t* ctx, int partner) {
+    return ctx->rows && ctx->node_rank[partner] >= 0;
+}
+
+
+bool shm_same_node(const shm_context_t* ctx, int partner) {
+    return ctx->node_rank[partner] >= 0;
+}
+
+
+// Pairwise barrier: after it, everything the partner wrote before it is visible here.
+// It also trades the index of the row holding the data, which may differ between the partners
+// (the message exchanges leave the kept elements in the receiving row).
+static int shm_pair_sync(shm_context_t* ctx, int partner, int row_index, int tag, MPI_Comm comm) {
+    int partner_index;
+    trace_wait_begin();
+    MPI_Win_sync(ctx->win);
+    MPI_Sendrecv(&row_index, 1, MPI_INT, partner, tag, &partner_index, 1, MPI_INT, partner, tag, comm, MPI_STATUS_IGNORE);
+    MPI_Win_sync(ctx->win);
+    trace_wait_end();
+    return partner_index;
+}
+
+
+// Compare-exchange directly on the partner's row
+void shm_pairwise_exchange(shm_context_t* ctx, int row_index, int rank, int partner, bool ascending,
+                           int num_threads, int tag, MPI_Comm comm) {
+    int cols = ctx->cols;
+
+    MPI_Aint segment_size;
+    int disp_unit;
+    elem_t* partner_rows;
+    MPI_Win_shared_query(ctx->win, ctx->node_rank[partner], &segment_size, &disp_unit, &partner_rows);
+
+    // Both rows must be final (previous merges done) before either process touches them
+    int partner_index = shm_pair_sync(ctx, partner, row_index, tag, comm);
+
+    elem_t* own_row = ctx->rows + (size_t)row_index * cols;
+    elem_t* other_row = partner_rows + (size_t)partner_index * cols;
+    elem_t* low_row  = (rank < partner) ? own_row : other_row;
+    elem_t* high_row = (rank < partner) ? other_row : own_row;
+
+    // The lower rank handles the first half of the columns, the higher rank the second half
+    int half = cols / 2;
+    int first = (rank < partner) ? 0 : half;
+    int last  = (rank < partner) ? half : cols;
+    int len = last - first;
+
+    int threads = num_threads;
+    if (threads > len / MIN_ELEMENTS_PER_THREAD) threads = len / MIN_ELEMENTS_PER_THREAD;
+    if (threads < 1) threads = 1;
+
+    #pragma omp parallel for num_threads(threads) schedule(static)
+    for (int t = 0; t < threads; t++) {
+        int lo = first + (int)((long long)len * t / threads);
+        int hi = first + (int)((long long)len * (t + 1) / threads);
+        pairwise_sort(low_row + lo, high_row + lo, hi - lo, ascending);
+    }
+
+    // Neither row may be used (or merged) until the partner's half is done as well
+    shm_pair_sync(ctx, partner, row_index, tag, comm);
+}
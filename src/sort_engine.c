@@ -0,0 +1,118 @@
+#include "../inc/sort_engine.h"
+
+
+// Number of bitonic stages for `rows` processes (virtual rows up to the next power of two)
+static int count_stages(int rows) {
+    int stages = 0;
+    while ((1 << stages) < rows) stages++;
+    return stages;
+}
+
+
+link_model_t sort_engine_calibrate(MPI_Comm comm) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    link_model_t model = { 0.0, DBL_MAX, 0.0 };
+
+    // Step 1: Pairwise exchanges with the farthest partner (processes without one only time the merge)
+    int stages = count_stages(size);
+    int partner = (stages > 0) ? rank ^ (1 << (stages - 1)) : size;
+    if (partner < size) {
+        char* send = calloc(PROBE_BYTES, 1);
+        char* recv = malloc(PROBE_BYTES);
+        if (!send || !recv) {
+            fprintf(stderr, "Rank %d: Memory allocation failed\n", rank);
+            MPI_Abort(comm, -1);
+        }
+
+        model.latency = exchange_probe(send, recv, 0, partner, comm);
+        double transfer = exchange_probe(send, recv, PROBE_BYTES, partner, comm) - model.latency;
+        model.bandwidth = PROBE_BYTES / (transfer > 0.0 ? transfer : 1e-9);
+
+        free(send);
+        free(recv);
+    }
+
+    // Step 2: Speed of a branchless merge of two interleaved runs. The destination is faulted in
+    // before the timed merges, and the fastest of them is kept, as for the exchanges
+    elem_t* runs = malloc(4 * MERGE_PROBE * sizeof(elem_t));
+    if (!runs) {
+        fprintf(stderr, "Rank %d: Memory allocation failed\n", rank);
+        MPI_Abort(comm, -1);
+    }
+    for (int i = 0; i < MERGE_PROBE; i++) {
+        KEY(runs[i]) = (sort_key_t)(2 * i);
+        KEY(runs[MERGE_PROBE + i]) = (sort_key_t)(2 * i + 1);
+    }
+    memset(runs + 2 * MERGE_PROBE, 0, 2 * MERGE_PROBE * sizeof(elem_t));
+    double best = DBL_MAX;
+    for (int i = 0; i < TUNING_REPEATS; i++) {
+        double start_time = MPI_Wtime();
+        merge_runs(runs, MERGE_PROBE, runs + MERGE_PROBE, MERGE_PROBE, runs + 2 * MERGE_PROBE, true);
+        double elapsed = MPI_Wtime() - start_time;
+        if (elapsed < best) best = elapsed;
+    }
+    model.merge_time = best / (2 * MERGE_PROBE);
+    free(runs);
+
+    // The slowest process and link set the pace
+    MPI_Allreduce(MPI_IN_PLACE, &model.latency, 1, MPI_DOUBLE, MPI_MAX, comm);
+    MPI_Allreduce(MPI_IN_PLACE, &model.bandwidth, 1, MPI_DOUBLE, MPI_MIN, comm);
+    MPI_Allreduce(MPI_IN_PLACE, &model.merge_time, 1, MPI_DOUBLE, MPI_MAX, comm);
+    return model;
+}
+
+
+sort_engine_t sort_engine_select(const link_model_t* model, int rows, int capacity, double* bitonic, double* sample) {
+    double stages = count_stages(rows);
+    double steps = stages * (stages + 1) / 2;
+    double row_bytes = (double)capacity * sizeof(elem_t);
+
+    // Bitonic: every step exchanges and compares a whole row, every stage ends with an elbow merge
+    double bitonic_time = steps * (model->latency + row_bytes / model->bandwidth)
+                        + (steps + stages) * capacity * model->merge_time;
+
+    // Sample sort: one message to every other process, (rows - 1) / rows of the row leaves,
+    // then the received runs are merged in log2(rows) passes
+    double sample_time = 2.0 * (rows - 1) * model->latency
+                       + (rows > 1 ? (double)(rows - 1) / rows : 0.0) * row_bytes / model->bandwidth
+                       + stages * capacity * model->merge_time;
+
+    if (bitonic) *bitonic = bitonic_time;
+    if (sample) *sample = sample_time;
+    return (sample_time < bitonic_time) ? ENGINE_SAMPLE : ENGINE_BITONIC;
+}
+
+
+void sort_engine_run(elem_t* local_row, int* count, int capacity, bool presorted, MPI_Comm comm) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    // A single process only sorts locally: nothing to calibrate. The streaming exchange is asked for
+    // its bounded memory, which the sample sort does not have
+    sort_engine_t engine = sort_config.engine;
+    if (engine == ENGINE_AUTO && (size == 1 || sort_config.exchange_mode == EXCHANGE_STREAM)) engine = ENGINE_BITONIC;
+    if (engine == ENGINE_AUTO) {
+        trace_begin(TRACE_CALIBRATE, -1, -1, -1);
+        link_model_t model = sort_engine_calibrate(comm);
+        trace_end();
+        double bitonic_time, sample_time;
+        engine = sort_engine_select(&model, size, capacity, &bitonic_time, &sample_time);
+
+        if (rank == 0) {
+            printf("Engine: %s (model: bitonic %.3f ms, sample %.3f ms | latency %.2f us, bandwidth %.2f GB/s, merge %.2f ns/element)\n",
+                   engine == ENGINE_SAMPLE ? "sample" : "bitonic", bitonic_time * 1e3, sample_time * 1e3,
+                   model.latency * 1e6, model.bandwidth / 1e9, model.merge_time * 1e9);
+            fflush(stdout);
+        }
+    }
+
+    if (engine == ENGINE_SAMPLE) {
+        sample_sort(local_row, count, capacity, presorted, comm);
+    } else {
+        bitonic_sort_any(local_row, count, capacity, presorted, comm);
+    }
+}
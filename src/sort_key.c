@@ -0,0 +1,26 @@
+#include "../inc/sort_key.h"
+
+// Datatype committed on first use (only the 64-bit pairs need one)
+static MPI_Datatype elem_type = MPI_DATATYPE_NULL;
+
+
+MPI_Datatype elem_mpi_type(void) {
+#if !SORT_PAYLOAD
+    return KEY_MPI_TYPE;
+#elif defined(SORT_KEY_INT32)
+    return MPI_2INT;
+#elif defined(SORT_KEY_FLOAT)
+    return MPI_FLOAT_INT;
+#else
+    if (elem_type == MPI_DATATYPE_NULL) {
+        MPI_Type_contiguous(2, MPI_INT64_T, &elem_type);
+        MPI_Type_commit(&elem_type);
+    }
+    return elem_type;
+#endif
+}
+
+
+void elem_mpi_type_release(void) {
+    if (elem_type != MPI_DATATYPE_NULL) MPI_Type_free(&elem_type);
+}
@@ -0,0 +1,76 @@
+#include "../inc/stream_exchange.h"
+
+
+int stream_exchange_block(int cols) {
+    long long bytes = sort_config.chunk_bytes > 0 ? sort_config.chunk_bytes : STREAM_BLOCK_BYTES;
+    int block = 1;
+    while ((long long)block * 2 * (long long)sizeof(elem_t) <= bytes && block * 2 <= cols) block *= 2;
+    return block;
+}
+
+
+int stream_sort_block(int cols, int block) {
+    int sort_block = block;
+    while ((long long)sort_block * 2 * (long long)sizeof(elem_t) <= STREAM_SORT_BYTES && sort_block * 2 <= cols) sort_block *= 2;
+    return sort_block;
+}
+
+
+void stream_exchange_init(stream_exchange_t* ex, int block) {
+    ex->block = block;
+    ex->ring = (elem_t*)arena_reserve(ARENA_RING, (size_t)STREAM_RING * block * sizeof(elem_t));
+    for (int s = 0; s < STREAM_RING; s++) {
+        ex->sends[s] = MPI_REQUEST_NULL;
+        ex->recvs[s] = MPI_REQUEST_NULL;
+    }
+}
+
+
+void stream_exchange_free(stream_exchange_t* ex) {
+    // The ring stays in the arena for the next sorts
+    ex->ring = NULL;
+}
+
+
+// Posts the exchange of block `b` through ring slot `b % STREAM_RING`
+static void post_block(stream_exchange_t* ex, elem_t* row, int cols, int b, int partner, int tag, MPI_Comm comm) {
+    int slot = b % STREAM_RING;
+    int offset = b * ex->block;
+    int len = (offset + ex->block <= cols) ? ex->block : cols - offset;
+    MPI_Irecv(ex->ring + (size_t)slot * ex->block, len, elem_mpi_type(), partner, tag, comm, &ex->recvs[slot]);
+    MPI_Isend(row + offset, len, elem_mpi_type(), partner, tag, comm, &ex->sends[slot]);
+}
+
+
+// Both partners send their own blocks in order and keep their side of every pair in place, so the
+// exchange is symmetric: block b is overwritten once the partner's block b has arrived and the own
+// one has left, then its slot serves block b + STREAM_RING
+void stream_exchange_run(stream_exchange_t* ex, elem_t* row, int cols, int partner, int tag, bool keep_min,
+                         int num_threads, MPI_Comm comm) {
+    int blocks = (cols + ex->block - 1) / ex->block;
+    for (int b = 0; b < blocks && b < STREAM_RING; b++) post_block(ex, row, cols, b, partner, tag, comm);
+    trace_bytes((long long)cols * sizeof(elem_t), (long long)cols * sizeof(elem_t));
+
+    for (int b = 0; b < blocks; b++) {
+        int slot = b % STREAM_RING;
+        int offset = b * ex->block;
+        int len = (offset + ex->block <= cols) ? ex->block : cols - offset;
+
+        trace_wait_begin();
+        MPI_Wait(&ex->recvs[slot], MPI_STATUS_IGNORE);
+        MPI_Wait(&ex->sends[slot], MPI_STATUS_IGNORE);
+        trace_wait_end();
+
+        // The threads share the block, in pieces that stay in cache
+        const elem_t* staged = ex->ring + (size_t)slot * ex->block;
+        int piece = (len + num_threads - 1) / num_threads;
+        #pragma omp parallel for num_threads(num_threads) schedule(static) if(len >= num_threads * MIN_ELEMENTS_PER_THREAD)
+        for (int t = 0; t < num_threads; t++) {
+            int lo = t * piece;
+            int hi = (lo + piece < len) ? lo + piece : len;
+            if (lo < hi) pairwise_keep(staged + lo, row + offset + lo, hi - lo, keep_min);
+        }
+
+        if (b + STREAM_RING < blocks) post_block(ex, row, cols, b + STREAM_RING, partner, tag, comm);
+    }
+}
@@ -0,0 +1,150 @@
+#define _GNU_SOURCE  // sched_getcpu
+#include "../inc/topology.h"
+#include "../inc/bitonic_sort.h"
+#include <sched.h>
+
+// Link classes, from the fastest to the slowest
+enum { LINK_SOCKET, LINK_NODE, LINK_NETWORK, NUM_LINKS };
+
+
+// Physical package of the cpu the process runs on (processes should be pinned for it to be stable)
+static int current_socket(void) {
+    int cpu = sched_getcpu();
+    if (cpu < 0) return 0;
+
+    char path[128];
+    snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/topology/physical_package_id", cpu);
+    FILE* file = fopen(path, "r");
+    if (!file) return 0;
+
+    int socket = 0;
+    if (fscanf(file, "%d", &socket) != 1) socket = 0;
+    fclose(file);
+    return socket;
+}
+
+
+// Node and socket of the current process, ranks are taken from `comm`
+static topology_slot_t local_slot(MPI_Comm comm) {
+    topology_slot_t slot;
+    MPI_Comm_rank(comm, &slot.rank);
+
+    // Processes sharing memory are on the same node, the lowest rank among them names it
+    MPI_Comm node_comm;
+    MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, slot.rank, MPI_INFO_NULL, &node_comm);
+    MPI_Allreduce(&slot.rank, &slot.node, 1, MPI_INT, MPI_MIN, node_comm);
+    MPI_Comm_free(&node_comm);
+
+    slot.socket = current_socket();
+    return slot;
+}
+
+
+// Orders slots by node, then socket, then original rank
+static int compare_slots(const void* a, const void* b) {
+    const topology_slot_t* x = (const topology_slot_t*)a;
+    const topology_slot_t* y = (const topology_slot_t*)b;
+    if (x->node != y->node) return (x->node > y->node) - (x->node < y->node);
+    if (x->socket != y->socket) return (x->socket > y->socket) - (x->socket < y->socket);
+    return (x->rank > y->rank) - (x->rank < y->rank);
+}
+
+
+static int link_class(const topology_slot_t* a, const topology_slot_t* b) {
+    if (a->node != b->node) return LINK_NETWORK;
+    return (a->socket != b->socket) ? LINK_NODE : LINK_SOCKET;
+}
+
+
+MPI_Comm topology_comm_create(MPI_Comm comm) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    topology_slot_t slot = local_slot(comm);
+    topology_slot_t* slots = malloc(size * sizeof(topology_slot_t));
+    if (!slots) {
+        fprintf(stderr, "Rank %d: Memory allocation failed\n", rank);
+        MPI_Abort(comm, -1);
+    }
+    MPI_Allgather(&slot, 3, MPI_INT, slots, 3, MPI_INT, comm);
+
+    // The new rank of a process is its position in the hierarchy order
+    qsort(slots, size, sizeof(topology_slot_t), compare_slots);
+    int new_rank = 0;
+    while (slots[new_rank].rank != rank) new_rank++;
+    free(slots);
+
+    MPI_Comm sorted_comm;
+    MPI_Comm_split(comm, 0, new_rank, &sorted_comm);
+    return sorted_comm;
+}
+
+
+// Bytes sent over every link class when the rows are numbered by `order`
+static void schedule_volume(const topology_slot_t* order, int size, long long row_bytes, long long bytes[NUM_LINKS]) {
+    bool flip = (sort_config.exchange_mode == EXCHANGE_SPLIT);
+    int stages = 0;
+    while ((1 << stages) < size) stages++;
+
+    for (int l = 0; l < NUM_LINKS; l++) bytes[l] = 0;
+    for (int r = 0; r < size; r++) {
+        for (int stage = 1; stage <= stages; stage++) {
+            for (int step = stage - 1; step >= 0; step--) {
+                int partner = bitonic_partner(r, stage, step, flip);
+                if (partner != r && partner < size) bytes[link_class(&order[r], &order[partner])] += row_bytes;
+            }
+        }
+    }
+}
+
+
+static void print_volume(const char* label, const long long bytes[NUM_LINKS]) {
+    long long total = bytes[LINK_SOCKET] + bytes[LINK_NODE] + bytes[LINK_NETWORK];
+    double scale = (total > 0) ? 100.0 / total : 0.0;
+    printf("Exchange volume (%s): intra-socket %.1f MB (%.1f%%) | inter-socket %.1f MB (%.1f%%) | inter-node %.1f MB (%.1f%%)\n",
+           label,
+           bytes[LINK_SOCKET] / 1e6, bytes[LINK_SOCKET] * scale,
+           bytes[LINK_NODE] / 1e6, bytes[LINK_NODE] * scale,
+           bytes[LINK_NETWORK] / 1e6, bytes[LINK_NETWORK] * scale);
+}
+
+
+void topology_report(MPI_Comm sort_comm, long long row_bytes) {
+    int rank, size;
+    MPI_Comm_rank(sort_comm, &rank);
+    MPI_Comm_size(sort_comm, &size);
+
+    // Slots carry the world rank and are gathered in the order of `sort_comm`
+    topology_slot_t slot = local_slot(MPI_COMM_WORLD);
+    topology_slot_t* sorted_order = NULL;
+    topology_slot_t* world_order = NULL;
+    if (rank == 0) {
+        sorted_order = malloc(size * sizeof(topology_slot_t));
+        world_order = malloc(size * sizeof(topology_slot_t));
+        if (!sorted_order || !world_order) {
+            fprintf(stderr, "Rank %d: Memory allocation failed\n", rank);
+            MPI_Abort(sort_comm, -1);
+        }
+    }
+    MPI_Gather(&slot, 3, MPI_INT, sorted_order, 3, MPI_INT, 0, sort_comm);
+
+    int same_order;
+    MPI_Comm_compare(sort_comm, MPI_COMM_WORLD, &same_order);
+
+    if (rank == 0) {
+        for (int r = 0; r < size; r++) world_order[sorted_order[r].rank] = sorted_order[r];
+
+        long long bytes[NUM_LINKS];
+        schedule_volume(world_order, size, row_bytes, bytes);
+        print_volume("world order", bytes);
+        if (same_order != MPI_IDENT && same_order != MPI_CONGRUENT) {
+            schedule_volume(sorted_order, size, row_bytes, bytes);
+            print_volume("remapped order", bytes);
+        }
+        fflush(stdout);
+
+        free(sorted_order);
+        free(world_order);
+    }
+}
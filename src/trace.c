@@ -0,0 +1,376 @@
+#include "../inc/trace.h"
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+static const char* kind_names[TRACE_NUM_KINDS] = {
+    "calibrate", "local_sort", "exchange", "shm_exchange", "compare_split", "merge", "splitters", "alltoall"
+};
+
+static const char* counter_names[TRACE_COUNTERS] = { "cycles", "instructions", "cache_misses" };
+
+// Trace state of the process (only the thread driving the sort records events)
+static bool          enabled = false;
+static double        origin;                        // MPI_Wtime of the common start
+static trace_event_t* events = NULL;
+static int           num_events = 0, cap_events = 0;
+static trace_event_t current;                       // Open event
+static bool          open_event = false;
+static double        wait_start;
+static int           counter_fds[TRACE_COUNTERS] = { -1, -1, -1 };
+static long long     traffic_sent = 0, traffic_received = 0;   // Every message byte, traced or not
+static long long     counter_start[TRACE_COUNTERS];
+
+
+// Opens the hardware counters of the calling thread and of every thread it starts later, all or none
+static bool counters_open(void) {
+#ifdef __linux__
+    const unsigned long long configs[TRACE_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES
+    };
+    for (int c = 0; c < TRACE_COUNTERS; c++) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.config = configs[c];
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.inherit = 1;   // Reads add up the threads created after the open (OpenMP team, progress and I/O threads)
+        counter_fds[c] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+        if (counter_fds[c] < 0) {
+            for (int o = 0; o <= c; o++) {
+                if (counter_fds[o] >= 0) close(counter_fds[o]);
+                counter_fds[o] = -1;
+            }
+            return false;
+        }
+    }
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+static void counters_close(void) {
+#ifdef __linux__
+    for (int c = 0; c < TRACE_COUNTERS; c++) {
+        if (counter_fds[c] >= 0) close(counter_fds[c]);
+        counter_fds[c] = -1;
+    }
+#endif
+}
+
+
+// Current value of every counter (-1 if unavailable)
+static void counters_read(long long* values) {
+    for (int c = 0; c < TRACE_COUNTERS; c++) {
+        values[c] = -1;
+#ifdef __linux__
+        long long value;
+        if (counter_fds[c] >= 0 && read(counter_fds[c], &value, sizeof(value)) == (ssize_t)sizeof(value)) values[c] = value;
+#endif
+    }
+}
+
+
+void trace_counters_open(void) {
+    if (sort_config.trace_prefix && sort_config.trace_counters && counter_fds[0] < 0) counters_open();
+}
+
+
+void trace_init(MPI_Comm comm) {
+    enabled = (sort_config.trace_prefix != NULL);
+    if (!enabled) return;
+
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+
+    if (sort_config.trace_counters) {
+        // Opened here only if `trace_counters_open` was skipped: the threads already running are then left out
+        int available = (counter_fds[0] >= 0) || counters_open();
+        MPI_Allreduce(MPI_IN_PLACE, &available, 1, MPI_INT, MPI_LAND, comm);
+        if (!available) {
+            counters_close();
+            if (rank == 0) printf("Trace: hardware counters unavailable (perf_event_open failed, see /proc/sys/kernel/perf_event_paranoid)\n");
+        }
+    }
+
+    MPI_Barrier(comm);
+    origin = MPI_Wtime();
+}
+
+
+bool trace_enabled(void) {
+    return enabled;
+}
+
+
+void trace_begin(trace_kind_t kind, int stage, int step, int partner) {
+    if (!enabled) return;
+
+    memset(&current, 0, sizeof(current));
+    current.kind = kind;
+    current.stage = stage;
+    current.step = step;
+    current.partner = partner;
+    counters_read(counter_start);
+    current.start = MPI_Wtime() - origin;
+    open_event = true;
+}
+
+
+void trace_wait_begin(void) {
+    if (!enabled || !open_event) return;
+    wait_start = MPI_Wtime();
+}
+
+
+void trace_wait_end(void) {
+    if (!enabled || !open_event) return;
+    current.wait += MPI_Wtime() - wait_start;
+}
+
+
+void trace_bytes(long long sent, long long received) {
+    traffic_sent += sent;
+    traffic_received += received;
+    if (!enabled || !open_event) return;
+    current.bytes_sent += sent;
+    current.bytes_received += received;
+}
+
+
+void trace_end(void) {
+    if (!enabled || !open_event) return;
+
+    current.duration = MPI_Wtime() - origin - current.start;
+    long long counter_end[TRACE_COUNTERS];
+    counters_read(counter_end);
+    for (int c = 0; c < TRACE_COUNTERS; c++) {
+        current.counters[c] = (counter_start[c] >= 0 && counter_end[c] >= 0) ? counter_end[c] - counter_start[c] : -1;
+    }
+
+    if (num_events == cap_events) {
+        int cap = (cap_events > 0) ? 2 * cap_events : 256;
+        trace_event_t* grown = realloc(events, cap * sizeof(trace_event_t));
+        if (!grown) {
+            fprintf(stderr, "Trace: Memory allocation failed, dropping events\n");
+            open_event = false;
+            return;
+        }
+        events = grown;
+        cap_events = cap;
+    }
+    events[num_events++] = current;
+    open_event = false;
+}
+
+
+void trace_traffic(long long* sent, long long* received) {
+    *sent = traffic_sent;
+    *received = traffic_received;
+    traffic_sent = traffic_received = 0;
+}
+
+
+// Name of an event in the timeline: the phase and its position in the network
+static void event_label(const trace_event_t* e, char* label, size_t len) {
+    if (e->stage >= 0) {
+        snprintf(label, len, "%s %d.%d", kind_names[e->kind], e->stage, e->step);
+    } else {
+        snprintf(label, len, "%s", kind_names[e->kind]);
+    }
+}
+
+
+static FILE* open_output(const char* suffix) {
+    char path[4096];
+    snprintf(path, sizeof(path), "%s%s", sort_config.trace_prefix, suffix);
+    FILE* file = fopen(path, "w");
+    if (!file) fprintf(stderr, "Rank 0: Cannot write the trace file %s\n", path);
+    return file;
+}
+
+
+static void write_csv(const trace_event_t* all, const int* counts, int size) {
+    FILE* file = open_output(".csv");
+    if (!file) return;
+
+    fprintf(file, "rank,kind,stage,step,partner,start_us,duration_us,compute_us,wait_us,bytes_sent,bytes_received");
+    for (int c = 0; c < TRACE_COUNTERS; c++) fprintf(file, ",%s", counter_names[c]);
+    fprintf(file, "\n");
+
+    for (int r = 0, i = 0; r < size; r++) {
+        for (int k = 0; k < counts[r]; k++, i++) {
+            const trace_event_t* e = &all[i];
+            fprintf(file, "%d,%s,%d,%d,%d,%.3f,%.3f,%.3f,%.3f,%lld,%lld", r, kind_names[e->kind], e->stage, e->step, e->partner,
+                    e->start * 1e6, e->duration * 1e6, (e->duration - e->wait) * 1e6, e->wait * 1e6, e->bytes_sent, e->bytes_received);
+            for (int c = 0; c < TRACE_COUNTERS; c++) fprintf(file, ",%lld", e->counters[c]);
+            fprintf(file, "\n");
+        }
+    }
+    fclose(file);
+}
+
+
+static void write_json(const trace_event_t* all, const int* counts, int size) {
+    FILE* file = open_output(".json");
+    if (!file) return;
+
+    // Per-process totals first, so the stragglers stand out without parsing the events
+    fprintf(file, "{\n  \"processes\": %d,\n  \"ranks\": [\n", size);
+    for (int r = 0, i = 0; r < size; r++) {
+        double busy = 0.0, wait = 0.0;
+        long long sent = 0, received = 0;
+        for (int k = 0; k < counts[r]; k++, i++) {
+            busy += all[i].duration;
+            wait += all[i].wait;
+            sent += all[i].bytes_sent;
+            received += all[i].bytes_received;
+        }
+        fprintf(file, "    { \"rank\": %d, \"events\": %d, \"duration_us\": %.3f, \"compute_us\": %.3f, \"wait_us\": %.3f, \"bytes_sent\": %lld, \"bytes_received\": %lld }%s\n",
+                r, counts[r], busy * 1e6, (busy - wait) * 1e6, wait * 1e6, sent, received, (r + 1 < size) ? "," : "");
+    }
+
+    fprintf(file, "  ],\n  \"events\": [\n");
+    int total = 0;
+    for (int r = 0; r < size; r++) total += counts[r];
+    for (int r = 0, i = 0; r < size; r++) {
+        for (int k = 0; k < counts[r]; k++, i++) {
+            const trace_event_t* e = &all[i];
+            fprintf(file, "    { \"rank\": %d, \"kind\": \"%s\", \"stage\": %d, \"step\": %d, \"partner\": %d, \"start_us\": %.3f, \"duration_us\": %.3f, \"compute_us\": %.3f, \"wait_us\": %.3f, \"bytes_sent\": %lld, \"bytes_received\": %lld",
+                    r, kind_names[e->kind], e->stage, e->step, e->partner, e->start * 1e6, e->duration * 1e6,
+                    (e->duration - e->wait) * 1e6, e->wait * 1e6, e->bytes_sent, e->bytes_received);
+            for (int c = 0; c < TRACE_COUNTERS; c++) fprintf(file, ", \"%s\": %lld", counter_names[c], e->counters[c]);
+            fprintf(file, " }%s\n", (i + 1 < total) ? "," : "");
+        }
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+}
+
+
+// Chrome trace event format (chrome://tracing, Perfetto): one timeline row per process
+static void write_chrome_trace(const trace_event_t* all, const int* counts, int size) {
+    FILE* file = open_output(".trace.json");
+    if (!file) return;
+
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    fprintf(file, "  {\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 0, \"args\": {\"name\": \"bitonic_mpi\"}}");
+    for (int r = 0; r < size; r++) {
+        fprintf(file, ",\n  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, \"tid\": %d, \"args\": {\"name\": \"rank %d\"}}", r, r);
+    }
+    for (int r = 0, i = 0; r < size; r++) {
+        for (int k = 0; k < counts[r]; k++, i++) {
+            const trace_event_t* e = &all[i];
+            char label[64];
+            event_label(e, label, sizeof(label));
+            fprintf(file, ",\n  {\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", \"pid\": 0, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f, "
+                          "\"args\": {\"partner\": %d, \"wait_us\": %.3f, \"bytes_sent\": %lld, \"bytes_received\": %lld",
+                    label, kind_names[e->kind], r, e->start * 1e6, e->duration * 1e6, e->partner, e->wait * 1e6, e->bytes_sent, e->bytes_received);
+            for (int c = 0; c < TRACE_COUNTERS; c++) {
+                if (e->counters[c] >= 0) fprintf(file, ", \"%s\": %lld", counter_names[c], e->counters[c]);
+            }
+            fprintf(file, "}}");
+        }
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+}
+
+
+// Slowest process (busiest, from the events) and the single longest wait
+static void print_summary(const trace_event_t* all, const int* counts, int size) {
+    int slowest = 0, longest = -1, longest_rank = 0;
+    double slowest_time = -1.0, slowest_wait = 0.0;
+    for (int r = 0, i = 0; r < size; r++) {
+        double busy = 0.0, wait = 0.0;
+        for (int k = 0; k < counts[r]; k++, i++) {
+            busy += all[i].duration;
+            wait += all[i].wait;
+            if (longest < 0 || all[i].wait > all[longest].wait) {
+                longest = i;
+                longest_rank = r;
+            }
+        }
+        if (busy > slowest_time) {
+            slowest = r;
+            slowest_time = busy;
+            slowest_wait = wait;
+        }
+    }
+
+    printf("Trace: slowest rank %d (%.3f ms, %.3f ms waiting)", slowest, slowest_time * 1e3, slowest_wait * 1e3);
+    if (longest >= 0 && all[longest].wait > 0.0) {
+        char label[64];
+        event_label(&all[longest], label, sizeof(label));
+        printf(", longest wait %.3f ms on rank %d in %s", all[longest].wait * 1e3, longest_rank, label);
+        if (all[longest].partner >= 0) printf(" (partner %d)", all[longest].partner);
+    }
+    printf(" -> %s.{csv,json,trace.json}\n", sort_config.trace_prefix);
+    fflush(stdout);
+}
+
+
+void trace_finalize(MPI_Comm comm) {
+    if (!enabled) return;
+
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    // Step 1: Gather the events of every process (in rank order)
+    int* counts = NULL;
+    int* byte_counts = NULL;
+    int* displs = NULL;
+    trace_event_t* all = NULL;
+    if (rank == 0) {
+        counts = malloc(size * sizeof(int));
+        byte_counts = malloc(size * sizeof(int));
+        displs = malloc(size * sizeof(int));
+        if (!counts || !byte_counts || !displs) {
+            fprintf(stderr, "Rank %d: Memory allocation failed\n", rank);
+            MPI_Abort(comm, -1);
+        }
+    }
+    MPI_Gather(&num_events, 1, MPI_INT, counts, 1, MPI_INT, 0, comm);
+
+    if (rank == 0) {
+        int total = 0;
+        for (int r = 0; r < size; r++) {
+            byte_counts[r] = counts[r] * (int)sizeof(trace_event_t);
+            displs[r] = total * (int)sizeof(trace_event_t);
+            total += counts[r];
+        }
+        all = malloc((total > 0 ? total : 1) * sizeof(trace_event_t));
+        if (!all) {
+            fprintf(stderr, "Rank %d: Memory allocation failed\n", rank);
+            MPI_Abort(comm, -1);
+        }
+    }
+    MPI_Gatherv(events, num_events * (int)sizeof(trace_event_t), MPI_BYTE, all, byte_counts, displs, MPI_BYTE, 0, comm);
+
+    // Step 2: Outputs
+    if (rank == 0) {
+        write_csv(all, counts, size);
+        write_json(all, counts, size);
+        write_chrome_trace(all, counts, size);
+        print_summary(all, counts, size);
+    }
+
+    // Clean up
+    free(counts);
+    free(byte_counts);
+    free(displs);
+    free(all);
+    free(events);
+    events = NULL;
+    num_events = cap_events = 0;
+    counters_close();
+    enabled = false;
+}
@@ -2,36 +2,45 @@
 
 
 // Local sort for a single row
-void local_sort(int* row, int cols, bool ascending) {
+void local_sort(elem_t* row, int cols, bool ascending) {
     #if SORT_VERSION == 0
         if (row == NULL || cols <= 0) {
             return;
         }
         
         // Comparison functions definitions
-        int compare_asc(const void* a, const void* b)  { return (*(int*)a - *(int*)b); }
-        int compare_desc(const void* a, const void* b) { return (*(int*)b - *(int*)a); }
+        int compare_asc(const void* a, const void* b) {
+            sort_key_t x = KEY(*(const elem_t*)a), y = KEY(*(const elem_t*)b);
+            return (x > y) - (x < y);
+        }
+        int compare_desc(const void* a, const void* b) { return compare_asc(b, a); }
         
         // Choose comparison function based on sort direction
         int (*compare_func)(const void*, const void*) = ascending ? compare_asc : compare_desc;
         
         // Call qsort with appropriate comparison function
-        qsort(row, cols, sizeof(int), compare_func);
+        qsort(row, cols, sizeof(elem_t), compare_func);
+
+    #elif SORT_VERSION == 1
+        // Both the slice sorts and the merges follow the requested order directly
+        parallel_local_sort(row, cols, ascending, sort_config.num_threads);
+
+    #elif SORT_VERSION == 2
+        // Radix sort handles the descending order directly (no reverse pass)
+        radix_sort(row, cols, ascending);
 
-    #else
-        // TODO: multithreaded sorting
     #endif
 }
 
 
 // Function to perform the initial alternating sort on each local row
-void initial_alternating_sort(int* row, int cols, int rank) {
+void initial_alternating_sort(elem_t* row, int cols, int rank) {
     bool ascending = (rank % 2 == 0);
     local_sort(row, cols, ascending);
 }
 
 
-void print_row(int* row, int cols, int rank, int size) {
+void print_row(elem_t* row, int cols, int rank, int size) {
     MPI_Barrier(MPI_COMM_WORLD);
 
     for (int i = 0; i < size; i++) {
@@ -48,7 +57,7 @@ void print_row(int* row, int cols, int rank, int size) {
             offset += snprintf(buffer + offset, buffer_size - offset, "Rank %d: ", rank);
 
             for (int j = 0; j < cols; j++) {
-                offset += snprintf(buffer + offset, buffer_size - offset, "%d, ", row[j]);
+                offset += snprintf(buffer + offset, buffer_size - offset, KEY_FORMAT ", ", KEY(row[j]));
                 if (offset >= buffer_size - 1) {
                     fprintf(stderr, "Rank %d: Buffer size exceeded\n", rank);
                     free(buffer);
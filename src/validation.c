@@ -1,15 +1,15 @@
 #include "../inc/validation.h"
 
 // Function to check if an array is sorted in ascending or descending order
-bool is_localy_sorted(int* row, int cols, bool* is_ascending) {
+bool is_localy_sorted(elem_t* row, int cols, bool* is_ascending) {
     bool ascending = true;
     bool descending = true;
 
     for (int i = 1; i < cols; i++) {
-        if (row[i] < row[i - 1]) {
+        if (KEY(row[i]) < KEY(row[i - 1])) {
             ascending = false; // Not ascending
         }
-        if (row[i] > row[i - 1]) {
+        if (KEY(row[i]) > KEY(row[i - 1])) {
             descending = false; // Not descending
         }
         if (!ascending && !descending) {
@@ -26,43 +26,175 @@ bool is_localy_sorted(int* row, int cols, bool* is_ascending) {
 }
 
 
-// Validates the correctness of the distributed bitonic sort
-void validate_bitonic_sort(int* local_row, int cols, int rank, int size, bool* eval) {
-    *eval = true;
+// Second hash of the fingerprint: the same finalizer on the salted first hash
+#define FINGERPRINT_SALT  0xD6E8FEB86659FD93ULL
+#define FINGERPRINT_WORDS (int)(sizeof(fingerprint_t) / sizeof(uint64_t))
 
-    // Step 1: Check if the local row is sorted in ascending order
-    for (int i = 0; i < cols - 1; i++) {
-        if (local_row[i] > local_row[i + 1]) {
-            fprintf(stderr, "Validation failed: Rank %d's local row is not sorted.\n", rank);
-            fflush(stderr);
-            *eval = false;
-            break;
-        }
+
+// Hash of an element: its key bits (and id with a payload) through the splitmix64 finalizer
+static inline uint64_t element_hash(elem_t e) {
+    sort_key_t key = KEY(e);
+    key_bits_t bits;
+    memcpy(&bits, &key, sizeof(bits));
+#if SORT_PAYLOAD
+    return mix64((uint64_t)bits ^ mix64((uint64_t)e.id + GOLDEN_GAMMA));
+#else
+    return mix64((uint64_t)bits);
+#endif
+}
+
+
+// Fingerprint of local elements, reduced over the threads
+void fingerprint_add(fingerprint_t* fp, const elem_t* row, int count) {
+    uint64_t sum = 0, sum2 = 0, xored = 0;
+    #pragma omp parallel for simd num_threads(sort_config.num_threads) schedule(static) reduction(+:sum, sum2) reduction(^:xored)
+    for (int i = 0; i < count; i++) {
+        uint64_t hash = element_hash(row[i]);
+        sum += hash;
+        sum2 += mix64(hash ^ FINGERPRINT_SALT);
+        xored ^= hash;
+    }
+    fp->count += (uint64_t)count;
+    fp->sum += sum;
+    fp->sum2 += sum2;
+    fp->xored ^= xored;
+}
+
+
+// Reduction of fingerprints: the counts and sums add up (mod 2^64), the xors combine
+static void fingerprint_combine(void* in, void* inout, int* len, MPI_Datatype* type) {
+    (void)type;
+    const fingerprint_t* a = in;
+    fingerprint_t* b = inout;
+    for (int i = 0; i < *len; i++) {
+        b[i].count += a[i].count;
+        b[i].sum += a[i].sum;
+        b[i].sum2 += a[i].sum2;
+        b[i].xored ^= a[i].xored;
+        b[i].disorder += a[i].disorder;
+    }
+}
+
+
+void fingerprint_reduce(fingerprint_t* fp, MPI_Comm comm) {
+    MPI_Datatype type;
+    MPI_Op op;
+    MPI_Type_contiguous(FINGERPRINT_WORDS, MPI_UINT64_T, &type);
+    MPI_Type_commit(&type);
+    MPI_Op_create(fingerprint_combine, 1, &op);
+    MPI_Allreduce(MPI_IN_PLACE, fp, 1, type, op, comm);
+    MPI_Op_free(&op);
+    MPI_Type_free(&type);
+}
+
+
+fingerprint_t fingerprint_rows(const elem_t* row, int count, MPI_Comm comm) {
+    fingerprint_t fp = { 0, 0, 0, 0, 0 };
+    fingerprint_add(&fp, row, count);
+    fingerprint_reduce(&fp, comm);
+    return fp;
+}
+
+
+bool fingerprint_equal(const fingerprint_t* a, const fingerprint_t* b) {
+    return a->count == b->count && a->sum == b->sum && a->sum2 == b->sum2 && a->xored == b->xored;
+}
+
+
+// Last key and count of a row, sent to the next rank
+typedef struct {
+    sort_key_t last;
+    int count;
+} boundary_t;
+
+
+// The last key of every row travels to the next one: a single nonblocking neighbor exchange
+static void post_boundary(boundary_t* mine, boundary_t* previous, MPI_Request* requests, int rank, int size, MPI_Comm comm) {
+    requests[0] = requests[1] = MPI_REQUEST_NULL;
+    previous->count = 0;
+    if (rank > 0) MPI_Irecv(previous, sizeof(*previous), MPI_BYTE, rank - 1, 0, comm, &requests[0]);
+    if (rank < size - 1) MPI_Isend(mine, sizeof(*mine), MPI_BYTE, rank + 1, 0, comm, &requests[1]);
+}
+
+
+// Order with the previous row, once its boundary has arrived
+static void check_boundary(const boundary_t* previous, sort_key_t first, int count, int rank, fingerprint_t* after) {
+    if (rank == 0 || count == 0) return;
+    if (previous->count == 0) {
+        fprintf(stderr, "Validation failed: Rank %d holds elements after the empty Rank %d.\n", rank, rank - 1);
+        after->disorder++;
+    } else if (previous->last > first) {
+        fprintf(stderr, "Validation failed: Rank %d's first element (" KEY_FORMAT ") is smaller than Rank %d's last element (" KEY_FORMAT ").\n",
+                rank, first, rank - 1, previous->last);
+        after->disorder++;
     }
+}
+
 
-    MPI_Barrier(MPI_COMM_WORLD);
+// A single reduction of the fingerprints and of the violations, then the verdict
+static bool complete_validation(fingerprint_t* after, const fingerprint_t* before, int rank, MPI_Comm comm) {
+    fingerprint_reduce(after, comm);
+    bool permutation = fingerprint_equal(after, before);
+    if (!permutation && rank == 0) {
+        fprintf(stderr, "Validation failed: the output is not a permutation of the input (%llu elements, fingerprint %016llx before; %llu elements, %016llx after).\n",
+                (unsigned long long)before->count, (unsigned long long)before->sum, (unsigned long long)after->count, (unsigned long long)after->sum);
+    }
+    fflush(stderr);
+    return permutation && after->disorder == 0;
+}
 
-    // Step 2: Check global order between ranks
-    int local_last_element = local_row[cols - 1];
-    int previous_last_element = 0;
 
-    if (rank < size - 1) {
-        // Send the last element to the next rank
-        MPI_Send(&local_last_element, 1, MPI_INT, rank + 1, 0, MPI_COMM_WORLD);
+// Branch-free count of the descents of a row (vectorized)
+uint64_t count_descents(const elem_t* row, int count) {
+    uint64_t descents = 0;
+    #pragma omp parallel for simd num_threads(sort_config.num_threads) schedule(static) reduction(+:descents)
+    for (int i = 1; i < count; i++) {
+        descents += (KEY(row[i]) < KEY(row[i - 1]));
     }
+    return descents;
+}
 
-    if (rank > 0) {
-        // Receive the last element from the previous rank
-        MPI_Recv(&previous_last_element, 1, MPI_INT, rank - 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
 
-        // Validate global order with the previous rank
-        if (previous_last_element > local_row[0]) {
-            fprintf(stderr, "Validation failed: Rank %d's first element (%d) is smaller than Rank %d's last element (%d).\n",
-                   rank, local_row[0], rank - 1, previous_last_element);
-            fflush(stderr);
-            *eval = false;
-        }
+// Validates the result of a distributed sort
+bool validate_sort(const elem_t* row, int count, const fingerprint_t* before, MPI_Comm comm) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    // Step 1: The boundary travels while the row is scanned
+    boundary_t mine = { count > 0 ? KEY(row[count - 1]) : 0, count }, previous;
+    MPI_Request requests[2];
+    post_boundary(&mine, &previous, requests, rank, size, comm);
+
+    // Step 2: Local order and fingerprint of the result
+    fingerprint_t after = { 0, 0, 0, 0, 0 };
+    fingerprint_add(&after, row, count);
+    after.disorder = count_descents(row, count);
+    if (after.disorder > 0) {
+        fprintf(stderr, "Validation failed: Rank %d's local row is not sorted (%llu descents).\n", rank, (unsigned long long)after.disorder);
     }
 
-    MPI_Barrier(MPI_COMM_WORLD);
+    // Step 3: Order with the previous row
+    MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+    check_boundary(&previous, count > 0 ? KEY(row[0]) : 0, count, rank, &after);
+
+    // Step 4: Permutation of the input and global verdict
+    return complete_validation(&after, before, rank, comm);
+}
+
+
+bool validate_scanned(sort_key_t first, sort_key_t last, int count, fingerprint_t* after, const fingerprint_t* before, MPI_Comm comm) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+
+    if (after->disorder > 0) {
+        fprintf(stderr, "Validation failed: Rank %d's local row is not sorted (%llu descents).\n", rank, (unsigned long long)after->disorder);
+    }
+    boundary_t mine = { last, count }, previous;
+    MPI_Request requests[2];
+    post_boundary(&mine, &previous, requests, rank, size, comm);
+    MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+    check_boundary(&previous, first, count, rank, after);
+    return complete_validation(after, before, rank, comm);
 }
@@ -0,0 +1,184 @@
+#include "../inc/wire_codec.h"
+
+#if defined(SORT_KEY_INT64)
+#define LEADING_ZEROS(x)  __builtin_clzll(x)
+#else
+#define LEADING_ZEROS(x)  __builtin_clz(x)
+#endif
+
+
+// The widths of the blocks follow the header, padded so that the packed words stay aligned
+static inline size_t widths_bytes(int blocks) {
+    return ((size_t)blocks + 7) / 8 * 8;
+}
+
+
+size_t wire_bound(int count) {
+    int blocks = (count + WIRE_BLOCK - 1) / WIRE_BLOCK;
+    size_t packed = widths_bytes(blocks) + (size_t)blocks * WIRE_BLOCK * sizeof(key_bits_t);
+    size_t raw = (size_t)count * sizeof(elem_t);
+    size_t bound = sizeof(wire_header_t) + ((packed > raw) ? packed : raw);
+    return (bound + 7) / 8 * 8;
+}
+
+
+#if !SORT_PAYLOAD
+// Signed differences map to small unsigned values: 0, -1, 1, -2, 2... become 0, 1, 2, 3, 4...
+static inline key_bits_t zigzag(key_bits_t delta) {
+    return (delta << 1) ^ ((key_bits_t)0 - (delta >> (KEY_BITS - 1)));
+}
+
+static inline key_bits_t unzigzag(key_bits_t value) {
+    return (value >> 1) ^ ((key_bits_t)0 - (value & 1));
+}
+
+
+// Packs the WIRE_BLOCK values of `in` at `width` bits into WIRE_LANES * width words: value
+// k * WIRE_LANES + l is the k-th one of lane l, so each of the KEY_BITS rounds shifts whole vectors
+static void pack_block(const key_bits_t* in, key_bits_t* out, int width) {
+    if (width == 0) return;
+    memset(out, 0, (size_t)WIRE_LANES * width * sizeof(key_bits_t));
+    for (int k = 0; k < KEY_BITS; k++) {
+        int bit = k * width, shift = bit % KEY_BITS;
+        key_bits_t* low = out + (bit / KEY_BITS) * WIRE_LANES;
+        const key_bits_t* values = in + k * WIRE_LANES;
+        for (int l = 0; l < WIRE_LANES; l++) low[l] |= values[l] << shift;
+        if (shift + width > KEY_BITS) {
+            key_bits_t* high = low + WIRE_LANES;
+            for (int l = 0; l < WIRE_LANES; l++) high[l] |= values[l] >> (KEY_BITS - shift);
+        }
+    }
+}
+
+
+static void unpack_block(const key_bits_t* in, key_bits_t* out, int width) {
+    if (width == 0) {
+        memset(out, 0, WIRE_BLOCK * sizeof(key_bits_t));
+        return;
+    }
+    const key_bits_t mask = (width == KEY_BITS) ? ~(key_bits_t)0 : (((key_bits_t)1 << width) - 1);
+    for (int k = 0; k < KEY_BITS; k++) {
+        int bit = k * width, shift = bit % KEY_BITS;
+        const key_bits_t* low = in + (bit / KEY_BITS) * WIRE_LANES;
+        key_bits_t* values = out + k * WIRE_LANES;
+        for (int l = 0; l < WIRE_LANES; l++) values[l] = low[l] >> shift;
+        if (shift + width > KEY_BITS) {
+            const key_bits_t* high = low + WIRE_LANES;
+            for (int l = 0; l < WIRE_LANES; l++) values[l] |= high[l] << (KEY_BITS - shift);
+        }
+        for (int l = 0; l < WIRE_LANES; l++) values[l] &= mask;
+    }
+}
+#endif
+
+
+size_t wire_encode(const elem_t* chunk, int count, double max_ratio, void* out) {
+    wire_header_t* header = out;
+    size_t raw = (size_t)count * sizeof(elem_t);
+    header->count = count;
+    header->packed = 0;
+    header->base = 0;
+
+#if !SORT_PAYLOAD
+    if (count > 0 && max_ratio > 0.0) {
+        int blocks = (count + WIRE_BLOCK - 1) / WIRE_BLOCK;
+        uint8_t* widths = (uint8_t*)(header + 1);
+        key_bits_t* words = (key_bits_t*)(widths + widths_bytes(blocks));
+        size_t used = sizeof(*header) + widths_bytes(blocks);
+        size_t limit = (size_t)(max_ratio * (sizeof(*header) + raw));
+        key_bits_t deltas[WIRE_BLOCK];
+        header->base = key_to_bits(chunk[0]);
+
+        for (int b = 0; b < blocks && used <= limit; b++) {
+            int lo = b * WIRE_BLOCK;
+            int len = (count - lo < WIRE_BLOCK) ? count - lo : WIRE_BLOCK;
+            const elem_t* keys = chunk + lo;
+
+            // Differences with the previous key (the first key of the chunk has none), zero padded
+            key_bits_t any = 0;
+            deltas[0] = zigzag(key_to_bits(keys[0]) - ((lo == 0) ? header->base : key_to_bits(keys[-1])));
+            any |= deltas[0];
+            for (int i = 1; i < len; i++) {
+                deltas[i] = zigzag(key_to_bits(keys[i]) - key_to_bits(keys[i - 1]));
+                any |= deltas[i];
+            }
+            for (int i = len; i < WIRE_BLOCK; i++) deltas[i] = 0;
+
+            int width = any ? KEY_BITS - LEADING_ZEROS(any) : 0;
+            widths[b] = (uint8_t)width;
+            pack_block(deltas, words, width);
+            words += (size_t)WIRE_LANES * width;
+            used += (size_t)WIRE_LANES * width * sizeof(key_bits_t);
+        }
+        if (used <= limit) {
+            header->packed = 1;
+            return used;
+        }
+    }
+#else
+    (void)max_ratio;
+#endif
+
+    memcpy(header + 1, chunk, raw);
+    return sizeof(*header) + raw;
+}
+
+
+int wire_decode(const void* in, elem_t* chunk) {
+    const wire_header_t* header = in;
+    int count = header->count;
+    if (!header->packed) {
+        memcpy(chunk, header + 1, (size_t)count * sizeof(elem_t));
+        return count;
+    }
+
+#if !SORT_PAYLOAD
+    int blocks = (count + WIRE_BLOCK - 1) / WIRE_BLOCK;
+    const uint8_t* widths = (const uint8_t*)(header + 1);
+    const key_bits_t* words = (const key_bits_t*)(widths + widths_bytes(blocks));
+    key_bits_t deltas[WIRE_BLOCK];
+    key_bits_t bits = header->base;
+
+    for (int b = 0; b < blocks; b++) {
+        int lo = b * WIRE_BLOCK;
+        int len = (count - lo < WIRE_BLOCK) ? count - lo : WIRE_BLOCK;
+        unpack_block(words, deltas, widths[b]);
+        words += (size_t)WIRE_LANES * widths[b];
+        for (int i = 0; i < len; i++) {
+            bits += unzigzag(deltas[i]);
+            chunk[lo + i] = bits_to_key(bits);
+        }
+    }
+#endif
+    return count;
+}
+
+
+double wire_codec_speed(void) {
+    elem_t* keys = malloc(2 * WIRE_PROBE * sizeof(elem_t));
+    void* wire = malloc(wire_bound(WIRE_PROBE));
+    if (!keys || !wire) {
+        free(keys);
+        free(wire);
+        return 0.0;
+    }
+
+    // Ascending keys a few units apart, as in a sorted row
+    key_bits_t bits = key_to_bits((sort_key_t)0);
+    for (int i = 0; i < WIRE_PROBE; i++) {
+        bits += (key_bits_t)((i * 2654435761u) >> 28);
+        KEY(keys[i]) = bits_to_key(bits);
+    }
+
+    double best = 1e30;
+    for (int r = 0; r < WIRE_REPEATS; r++) {
+        double start_time = MPI_Wtime();
+        wire_encode(keys, WIRE_PROBE, 1.0, wire);
+        wire_decode(wire, keys + WIRE_PROBE);
+        double elapsed = MPI_Wtime() - start_time;
+        if (elapsed < best) best = elapsed;
+    }
+    free(keys);
+    free(wire);
+    return WIRE_PROBE * sizeof(elem_t) / (best > 0.0 ? best : 1e-9);
+}